@@ -0,0 +1,161 @@
+// Generate the table of best-known palettes for the predefined color spaces
+// (inst/extdata/best-palettes.bin.gz), which qualpal() serves instead of
+// searching when it is asked for one of them.
+//
+// For every predefined color space, every color vision deficiency in the
+// grid below, and n = 2, ..., 99, the swap search is started from the usual
+// linearly spaced colors and from `starts` random selections of the 1000
+// candidate colors; the palette with the largest smallest color difference
+// wins, and the usual one wins ties, so the table is never worse than the
+// search. Build and run from the package root with
+//
+//   g++ -std=c++11 -O2 -pthread -Isrc data-raw/gen-best-palettes.cpp \
+//     -o gen-best-palettes
+//   ./gen-best-palettes 64 | gzip -9 > inst/extdata/best-palettes.bin.gz
+//
+// The seed is fixed, so the shipped table can be checked with
+//
+//   ./gen-best-palettes 64 | cmp - <(zcat inst/extdata/best-palettes.bin.gz)
+//
+// The file holds little-endian unsigned 16-bit integers: the magic numbers
+// 0x5051 and 0x4250 ("QPBP"), the format version, the number of candidate
+// colors, the smallest and largest n, the number of color spaces, and the
+// number of severities followed by the severities (in hundredths). Then, for
+// each color space (in the order of predefined_colorspaces()), for normal
+// vision and then each type of deficiency (protan, deutan, tritan) at each
+// severity, and for each n, come the n 0-based indices of the palette's
+// colors in qualpal() order.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "engine.h"
+
+namespace {
+
+const char* const spaces[] = {"pretty", "pretty_dark", "rainbow", "pastels"};
+const std::uint16_t severities[] = {25, 50, 75, 100};
+const std::size_t n_points = 1000;
+const std::size_t n_min = 2;
+const std::size_t n_max = 99;
+
+void write_u16(std::uint16_t x) {
+  std::putchar(x & 0xff);
+  std::putchar(x >> 8);
+}
+
+double min_distance(const std::vector<double>& dm,
+                    const std::vector<std::size_t>& r) {
+  double out = std::numeric_limits<double>::infinity();
+  for (std::size_t i = 0; i < r.size(); ++i)
+    for (std::size_t j = 0; j < i; ++j)
+      out = std::min(out, qualpal::dist_at(dm.data(), n_points, r[i], r[j]));
+  return out;
+}
+
+// Search from the usual start and from random ones, keeping the best
+// palette. The candidates are stored in Morton order (see locality.h), so
+// the searches start from and break ties by the original order, as
+// select_palette() does, and return indices in the original order.
+std::vector<std::size_t> best_palette(const qualpal::candidate_set& c,
+                                      std::size_t n,
+                                      std::size_t starts,
+                                      std::mt19937& rng) {
+  const double* d = c.dm.data();
+  qualpal::search_options opts;
+  opts.tie_rank = c.order.order.data();
+  qualpal::search_diagnostics diag;
+
+  std::vector<std::size_t> best =
+    qualpal::select_palette(c, n, 0, qualpal::search_options()).indices;
+  for (std::size_t i = 0; i < n; ++i)
+    best[i] = c.order.rank[best[i]];
+  double best_score = min_distance(c.dm, best);
+
+  std::vector<std::size_t> all(n_points);
+  for (std::size_t i = 0; i < n_points; ++i)
+    all[i] = i;
+
+  for (std::size_t s = 0; s < starts; ++s) {
+    // Partial Fisher-Yates shuffle for n distinct random candidates
+    for (std::size_t i = 0; i < n; ++i) {
+      std::uniform_int_distribution<std::size_t> pick(i, n_points - 1);
+      std::swap(all[i], all[pick(rng)]);
+    }
+    std::vector<std::size_t> r(n);
+    for (std::size_t i = 0; i < n; ++i)
+      r[i] = c.order.rank[all[i]];
+    qualpal::swap_search(d, n_points, r, opts, diag);
+
+    const double score = min_distance(c.dm, r);
+    if (score > best_score) {
+      best_score = score;
+      best = qualpal::order_selection(d, n_points, r);
+    }
+  }
+
+  for (std::size_t i = 0; i < n; ++i)
+    best[i] = c.order.order[best[i]];
+  return best;
+}
+
+void write_palettes(const qualpal::palette_request& req,
+                    std::size_t starts,
+                    std::mt19937& rng) {
+  std::shared_ptr<const qualpal::candidate_set> c =
+    qualpal::make_candidates(req, 0);
+
+  for (std::size_t n = n_min; n <= n_max; ++n) {
+    std::vector<std::size_t> r = best_palette(*c, n, starts, rng);
+    for (std::size_t i = 0; i < n; ++i)
+      write_u16(static_cast<std::uint16_t>(r[i]));
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const std::size_t starts = argc > 1 ? std::strtoul(argv[1], 0, 10) : 64;
+  const std::size_t n_spaces = sizeof(spaces)/sizeof(spaces[0]);
+  const std::size_t n_severities = sizeof(severities)/sizeof(severities[0]);
+
+  write_u16(0x5051);
+  write_u16(0x4250);
+  write_u16(1);
+  write_u16(n_points);
+  write_u16(n_min);
+  write_u16(n_max);
+  write_u16(n_spaces);
+  write_u16(n_severities);
+  for (std::size_t k = 0; k < n_severities; ++k)
+    write_u16(severities[k]);
+
+  std::mt19937 rng(20261018);
+
+  for (std::size_t i = 0; i < n_spaces; ++i) {
+    qualpal::palette_request req;
+    req.n_points = n_points;
+    qualpal::predefined_colorspace(spaces[i], req.box);
+
+    write_palettes(req, starts, rng);
+
+    const qualpal::cvd_type types[] = {qualpal::cvd_protan,
+                                       qualpal::cvd_deutan,
+                                       qualpal::cvd_tritan};
+    for (std::size_t t = 0; t < 3; ++t) {
+      for (std::size_t k = 0; k < n_severities; ++k) {
+        req.cvd = types[t];
+        req.cvd_severity = severities[k]/100.0;
+        write_palettes(req, starts, rng);
+      }
+    }
+
+    std::fprintf(stderr, "%s done\n", spaces[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,651 @@
+// Differential fuzzing of the optimized native paths against the reference
+// implementation in reference.h.
+//
+// Every check compares a fast path with the original algorithm on the same
+// candidate set:
+//
+// * distance_matrix() must reproduce reference::edist() bit for bit,
+// * every swap strategy must select exactly the same indices, in the same
+//   order, as reference::farthest_points() (with the same iteration cap, so
+//   that inputs on which the swaps cycle are covered too), with scratch
+//   memory from the heap as well as from an arena, and also on the
+//   candidates in Morton order (mapping the result back),
+// * divide and conquer must match the reference when the candidates fit
+//   into one region, and pick n candidates (distinct where the reference's
+//   are) when they do not,
+// * the k-d tree must find the same nearest neighbours as brute force, and
+//   the local strategy must end on a selection that no full pass of the
+//   scan changes (a different one than the reference's, possibly),
+// * the metric tree search must match the reference on DIN99d coordinates,
+//   and the reference on a full CIEDE2000 distance matrix under CIEDE2000,
+//   also for palettes from a few hundred random sRGB colors,
+// * the largest palette for a target difference must reach the target, and
+//   the reference search must miss it with one color more than the upper
+//   bound allows,
+// * the grid coreset, which is approximate by design, must keep every input
+//   color within one cell diagonal of a representative,
+// * a palette session moved through random HSL boxes must hold exactly the
+//   lattice points in each box, with the colors, coordinates, and distances
+//   that converting them from scratch gives, and a palette of distinct
+//   candidates.
+//
+// Built normally, this runs a property-based test over random and
+// adversarial candidate sets (duplicates, collinear and lattice points,
+// identical colors, tiny sets). Built with -DQUALPAL_LIBFUZZER and
+// -fsanitize=fuzzer, it provides a libFuzzer entry point instead that
+// decodes candidate sets from the fuzzer's bytes.
+//
+// Usage: fuzz-farthest-points [--iterations K] [--seed S]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "coreset.h"
+#include "divide_conquer.h"
+#include "distance.h"
+#include "farthest_points.h"
+#include "knn_graph.h"
+#include "locality.h"
+#include "max_n.h"
+#include "metric_tree.h"
+#include "reference.h"
+#include "session.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Keep cycling inputs cheap
+const std::size_t max_iterations = 50;
+
+struct candidate_case {
+  std::string kind;
+  std::vector<double> lab;  // row-major DIN99d-like coordinates
+  std::size_t n;
+
+  std::size_t size() const { return lab.size()/3; }
+};
+
+std::string describe(const candidate_case& c) {
+  std::ostringstream out;
+  out << c.kind << " case, N = " << c.size() << ", n = " << c.n << ":";
+  for (std::size_t i = 0; i < c.size(); ++i)
+    out << " (" << c.lab[3*i] << ", " << c.lab[3*i + 1] << ", "
+        << c.lab[3*i + 2] << ")";
+  return out.str();
+}
+
+std::string describe(const std::vector<std::size_t>& r) {
+  std::ostringstream out;
+  for (std::size_t i = 0; i < r.size(); ++i)
+    out << (i > 0 ? " " : "") << r[i];
+  return out.str();
+}
+
+const char* strategy_name(qualpal::swap_strategy s) {
+  return s == qualpal::swap_scan ? "scan"
+         : s == qualpal::swap_pruned ? "pruned" : "heap";
+}
+
+// Returns an empty string if all fast paths agree with the reference
+std::string check(const candidate_case& c, qualpal::thread_pool& pool) {
+  const std::size_t N = c.size();
+
+  std::vector<double> dm_ref = qualpal::reference::edist(c.lab);
+  std::vector<double> dm = qualpal::distance_matrix(c.lab, &pool, 1 + N % 7);
+
+  for (std::size_t k = 0; k < dm.size(); ++k)
+    if (dm[k] != dm_ref[k])
+      return "distance_matrix differs from edist";
+
+  std::vector<std::size_t> expected =
+    qualpal::reference::farthest_points(dm_ref, N, c.n, max_iterations);
+
+  const qualpal::swap_strategy strategies[] = {
+    qualpal::swap_scan, qualpal::swap_pruned, qualpal::swap_heap
+  };
+  const std::size_t pivots[] = {1, 8};
+
+  for (int s = 0; s < 3; ++s) {
+    for (int p = 0; p < 2; ++p) {
+      qualpal::search_options opts;
+      opts.strategy = strategies[s];
+      opts.n_pivots = pivots[p];
+      opts.max_iterations = max_iterations;
+
+      qualpal::search_diagnostics diag;
+      std::vector<std::size_t> got =
+        qualpal::farthest_points(dm.data(), N, c.n, opts, diag);
+
+      // The same search with scratch memory from an arena
+      if (got == expected && p == 0) {
+        qualpal::arena_scope scratch(qualpal::thread_arena(),
+                                     qualpal::search_scratch_bytes(N, c.n, opts));
+        qualpal::search_diagnostics arena_diag;
+        got = qualpal::farthest_points(dm.data(), N, c.n, opts, arena_diag);
+      }
+
+      if (got != expected) {
+        std::ostringstream out;
+        out << strategy_name(strategies[s]) << " (" << pivots[p]
+            << " pivots) selected " << describe(got) << ", reference "
+            << describe(expected);
+        return out.str();
+      }
+    }
+  }
+
+  // The same searches on the candidates in Morton order, which must break
+  // ties as if they had not been reordered
+  const qualpal::candidate_order order = qualpal::morton_order(c.lab);
+  const std::vector<double> dm_sorted =
+    qualpal::distance_matrix(qualpal::permute_rows(c.lab, order.order));
+
+  for (int s = 0; s < 3; ++s) {
+    qualpal::search_options opts;
+    opts.strategy = strategies[s];
+    opts.max_iterations = max_iterations;
+    opts.tie_rank = order.order.data();
+
+    std::vector<std::size_t> r = qualpal::initial_selection(N, c.n);
+    for (std::size_t i = 0; i < r.size(); ++i)
+      r[i] = order.rank[r[i]];
+
+    qualpal::search_diagnostics diag;
+    qualpal::swap_search(dm_sorted.data(), N, r, opts, diag);
+    std::vector<std::size_t> got =
+      qualpal::order_selection(dm_sorted.data(), N, r);
+    for (std::size_t i = 0; i < got.size(); ++i)
+      got[i] = order.order[got[i]];
+
+    if (got != expected) {
+      std::ostringstream out;
+      out << strategy_name(strategies[s]) << " in Morton order selected "
+          << describe(got) << ", reference " << describe(expected);
+      return out.str();
+    }
+  }
+
+  // The neighbour graph, and the local search on it
+  {
+    const qualpal::knn_graph graph =
+      qualpal::make_knn_graph(c.lab.data(), N, 1 + N % 9, &pool);
+
+    for (std::size_t q = 0; q < N; ++q) {
+      std::vector<std::pair<double, std::size_t> > all;
+      for (std::size_t j = 0; j < N; ++j) {
+        if (j == q)
+          continue;
+        double d2 = 0;
+        for (int a = 0; a < 3; ++a)
+          d2 += (c.lab[3*q + a] - c.lab[3*j + a])*(c.lab[3*q + a] - c.lab[3*j + a]);
+        all.push_back(std::make_pair(d2, j));
+      }
+      std::sort(all.begin(), all.end());
+      for (std::size_t j = 0; j < graph.k; ++j) {
+        if (graph.neighbors[q*graph.k + j] != all[j].second) {
+          std::ostringstream out;
+          out << "neighbour " << j << " of candidate " << q << " is "
+              << graph.neighbors[q*graph.k + j] << ", expected "
+              << all[j].second;
+          return out.str();
+        }
+      }
+    }
+
+    qualpal::search_options opts;
+    opts.strategy = qualpal::swap_local;
+    opts.max_iterations = max_iterations;
+    opts.neighbors = graph.neighbors.data();
+    opts.n_neighbors = graph.k;
+
+    std::vector<std::size_t> r = qualpal::initial_selection(N, c.n);
+    qualpal::search_diagnostics diag;
+    qualpal::swap_search(dm.data(), N, r, opts, diag);
+
+    if (!diag.capped) {
+      qualpal::search_options scan;
+      scan.strategy = qualpal::swap_scan;
+      scan.max_iterations = 1;
+      std::vector<std::size_t> again = r;
+      qualpal::search_diagnostics scan_diag;
+      qualpal::swap_search(dm.data(), N, again, scan, scan_diag);
+      if (again != r) {
+        std::ostringstream out;
+        out << "local search stopped at " << describe(r)
+            << ", but a scan moves on to " << describe(again);
+        return out.str();
+      }
+    }
+  }
+
+  // The metric tree, under the DIN99d difference and under CIEDE2000
+  {
+    qualpal::search_options opts;
+    opts.max_iterations = max_iterations;
+    const qualpal::coordinate_metric din99d = {c.lab.data(),
+                                               qualpal::metric_din99d};
+    qualpal::search_diagnostics diag;
+    std::vector<std::size_t> got =
+      qualpal::tree_farthest_points(din99d, N, c.n, opts, diag);
+    if (got != expected) {
+      std::ostringstream out;
+      out << "metric tree selected " << describe(got) << ", reference "
+          << describe(expected);
+      return out.str();
+    }
+
+    const qualpal::ciede2000_metric de2000(c.lab);
+    std::vector<double> dm_de2000(N*N);
+    for (std::size_t i = 0; i < N; ++i)
+      for (std::size_t j = 0; j < N; ++j)
+        dm_de2000[i + j*N] = i == j ? 0 : de2000(i, j);
+    const std::vector<std::size_t> expected_de2000 =
+      qualpal::reference::farthest_points(dm_de2000, N, c.n, max_iterations);
+
+    qualpal::search_diagnostics diag_de2000;
+    got = qualpal::tree_farthest_points(de2000, N, c.n, opts, diag_de2000);
+    if (got != expected_de2000) {
+      std::ostringstream out;
+      out << "metric tree selected " << describe(got) << " under CIEDE2000, "
+          << "reference " << describe(expected_de2000);
+      return out.str();
+    }
+  }
+
+  // The largest palette for the distance between two random candidates
+  {
+    const double target = dm[(c.n % N) + ((N - 1 - c.n % N)*N)];
+    const qualpal::max_n_result got =
+      qualpal::max_n_points(dm.data(), N, target, N);
+    const std::size_t n = got.indices.size();
+    std::ostringstream out;
+
+    if (n > 0 && (n < 2 || n < got.lower || n > got.upper ||
+                  got.min_de < target))
+      out << "max_n_points selected " << describe(got.indices) << " (min "
+          << got.min_de << ") for target " << target << ", bounds "
+          << got.lower << " to " << got.upper;
+    else if (n == 0 && *std::max_element(dm.begin(), dm.end()) >= target &&
+             target > 0)
+      out << "max_n_points found no palette for target " << target;
+    else if (got.upper > 0 && got.upper < N) {
+      const std::vector<std::size_t> more = qualpal::reference::farthest_points(
+        dm_ref, N, got.upper + 1, max_iterations);
+      if (qualpal::selection_min(dm.data(), N, more) >= target)
+        out << "max_n_points bounded n by " << got.upper << ", but "
+            << describe(more) << " reaches " << target;
+    }
+
+    if (!out.str().empty())
+      return out.str();
+  }
+
+  // Divide and conquer, in a single region and in regions of 4n candidates
+  const std::size_t region_sizes[] = {N, 1};
+  for (int k = 0; k < 2; ++k) {
+    qualpal::search_options opts;
+    opts.max_iterations = max_iterations;
+    qualpal::divide_options dopts;
+    dopts.region_size = region_sizes[k];
+
+    qualpal::search_diagnostics diag;
+    std::size_t n_regions = 0;
+    std::vector<std::size_t> got = qualpal::divide_farthest_points(
+      c.lab.data(), N, c.n, opts, dopts, diag, n_regions, &pool);
+
+    // The original algorithm repeats candidates when all of them coincide,
+    // so only ask for distinct ones when the reference has them
+    std::vector<std::size_t> sorted = got, sorted_ref = expected;
+    std::sort(sorted.begin(), sorted.end());
+    std::sort(sorted_ref.begin(), sorted_ref.end());
+    const bool distinct =
+      std::unique(sorted.begin(), sorted.end()) == sorted.end() ||
+      std::unique(sorted_ref.begin(), sorted_ref.end()) != sorted_ref.end();
+    const bool valid = got.size() == c.n && distinct &&
+      *std::max_element(got.begin(), got.end()) < N;
+
+    if (!valid || (k == 0 && got != expected)) {
+      std::ostringstream out;
+      out << "divide and conquer (" << n_regions << " regions) selected "
+          << describe(got) << ", reference " << describe(expected);
+      return out.str();
+    }
+  }
+
+  return "";
+}
+
+// Feed colors (as sRGB) to a small coreset and check that it covers them
+std::string check_coreset(const std::vector<double>& rgb, std::size_t capacity) {
+  qualpal::grid_coreset coreset(capacity);
+  for (std::size_t i = 0; i < rgb.size()/3; ++i)
+    coreset.add(&rgb[3*i]);
+
+  if (coreset.size() > capacity)
+    return "coreset exceeds its capacity";
+
+  std::vector<double> reps(3*coreset.size());
+  for (std::size_t j = 0; j < coreset.size(); ++j) {
+    double xyz[3];
+    qualpal::rgb_xyz(&coreset.rgb()[3*j], xyz);
+    qualpal::xyz_din99d(xyz, &reps[3*j]);
+  }
+
+  const double bound =
+    std::max(coreset.cell_width(), 1e-6)*std::sqrt(3.0)*(1 + 1e-9);
+
+  for (std::size_t i = 0; i < rgb.size()/3; ++i) {
+    double xyz[3], lab[3];
+    qualpal::rgb_xyz(&rgb[3*i], xyz);
+    qualpal::xyz_din99d(xyz, lab);
+
+    double d = std::numeric_limits<double>::infinity();
+    for (std::size_t j = 0; j < coreset.size(); ++j)
+      d = std::min(d, qualpal::euclidean_distance(lab, &reps[3*j]));
+
+    if (d > bound) {
+      std::ostringstream out;
+      out << "coreset leaves color " << i << " at distance " << d
+          << " from all representatives (bound " << bound << ")";
+      return out.str();
+    }
+  }
+
+  return "";
+}
+
+// Select palettes under CIEDE2000 from a few hundred random sRGB colors,
+// which the random cases above are too small and too artificial to stress,
+// and compare them with the reference on the full CIEDE2000 matrix
+std::string check_ciede2000(unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  const std::size_t N = 200 + rng() % 200, n = 3 + rng() % 10;
+  std::vector<double> din99d(3*N);
+  for (std::size_t i = 0; i < N; ++i) {
+    double rgb[3], xyz[3];
+    for (int k = 0; k < 3; ++k)
+      rgb[k] = unit(rng);
+    qualpal::rgb_xyz(rgb, xyz);
+    qualpal::xyz_din99d(xyz, &din99d[3*i]);
+  }
+
+  const qualpal::ciede2000_metric de2000(din99d);
+  std::vector<double> dm(N*N);
+  for (std::size_t i = 0; i < N; ++i)
+    for (std::size_t j = 0; j < N; ++j)
+      dm[i + j*N] = i == j ? 0 : de2000(i, j);
+  const std::vector<std::size_t> expected =
+    qualpal::reference::farthest_points(dm, N, n, max_iterations);
+
+  qualpal::search_options opts;
+  opts.max_iterations = max_iterations;
+  qualpal::search_diagnostics diag;
+  const std::vector<std::size_t> got =
+    qualpal::tree_farthest_points(de2000, N, n, opts, diag);
+
+  if (got != expected) {
+    std::ostringstream out;
+    out << "metric tree selected " << describe(got) << " under CIEDE2000 "
+        << "from " << N << " sRGB colors (seed " << seed << "), reference "
+        << describe(expected);
+    return out.str();
+  }
+
+  return "";
+}
+
+// Move a session through random, mostly nearby HSL boxes and check its
+// candidates after every update against a conversion from scratch
+std::string check_session(std::mt19937& rng, qualpal::thread_pool& pool) {
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  qualpal::session_options opts;
+  opts.n_points = 20 + rng() % 150;
+  opts.frame_budget = 0;
+  opts.cvd_severity = rng() % 2 ? unit(rng) : 0;
+  opts.metric = rng() % 4 ? qualpal::metric_din99d : qualpal::metric_euclidean;
+  const std::size_t n = 2 + rng() % 10;
+  qualpal::palette_session session(n, opts, &pool);
+
+  qualpal::hsl_box box = {{0, 360}, {0, 1}, {0, 1}};
+  std::ostringstream out;
+
+  for (int step = 0; step < 12; ++step) {
+    // Small moves of one edge, with an occasional jump or empty range
+    const int edge = rng() % 6;
+    double* x = edge < 2 ? &box.h[edge] : edge < 4 ? &box.s[edge - 2] :
+      &box.l[edge - 4];
+    const double scale = edge < 2 ? 360 : 1;
+    *x += scale*(rng() % 8 ? 0.05 : 0.5)*(unit(rng) - 0.5);
+    if (rng() % 16 == 0)
+      *x = edge % 2 ? x[-1] : x[1];
+    box.h[0] = std::min(std::max(box.h[0], -360.0), 360.0);
+    box.h[1] = std::min(std::max(box.h[1], box.h[0]), box.h[0] + 360);
+    box.h[1] = std::min(box.h[1], 360.0);
+    for (int k = 0; k < 2; ++k) {
+      box.s[k] = std::min(std::max(box.s[k], 0.0), 1.0);
+      box.l[k] = std::min(std::max(box.l[k], 0.0), 1.0);
+    }
+    std::sort(box.s, box.s + 2);
+    std::sort(box.l, box.l + 2);
+
+    session.update(box);
+    const std::size_t N = session.size();
+    out << "box (" << box.h[0] << ", " << box.h[1] << "; " << box.s[0]
+        << ", " << box.s[1] << "; " << box.l[0] << ", " << box.l[1]
+        << ") at step " << step << ", lattice " << session.lattice() << ": ";
+
+    if (session.lattice() > 0) {
+      std::vector<std::size_t> expected;
+      for (std::size_t k = 0; k < session.lattice(); ++k) {
+        double u[3];
+        qualpal::torus_point(k, u);
+        if (qualpal::in_hsl_box(box, u))
+          expected.push_back(k);
+      }
+      if (session.ids() != expected) {
+        out << "the session holds " << N << " lattice points, not "
+            << expected.size();
+        return out.str();
+      }
+    }
+
+    std::vector<double> rgb(3*N);
+    for (std::size_t i = 0; i < N; ++i)
+      qualpal::hsl_rgb(&session.hsl()[3*i], &rgb[3*i]);
+    std::vector<double> simulated, din99d;
+    qualpal::convert_colors(rgb, opts.cvd, opts.cvd_severity, simulated,
+                            din99d);
+    if (simulated != session.rgb() || din99d != session.din99d()) {
+      out << "the session's colors differ from a fresh conversion";
+      return out.str();
+    }
+
+    const std::vector<double> dm =
+      qualpal::distance_matrix(din99d, &pool, 64, opts.metric);
+    if (dm != session.distances()) {
+      out << "the session's distances differ from a fresh matrix";
+      return out.str();
+    }
+
+    const std::vector<std::size_t>& r = session.palette();
+    std::vector<std::size_t> sorted = r;
+    std::sort(sorted.begin(), sorted.end());
+    // As in the reference, candidates repeat when all of them coincide
+    const bool distinct =
+      std::unique(sorted.begin(), sorted.end()) == sorted.end() ||
+      *std::max_element(dm.begin(), dm.end()) == 0;
+    if (r.size() != n || sorted.back() >= N || !distinct ||
+        qualpal::selection_min(dm.data(), N, r) != session.min_de()) {
+      out << "the session's palette " << describe(r) << " (min "
+          << session.min_de() << ") is not valid";
+      return out.str();
+    }
+
+    out.str("");
+  }
+
+  return "";
+}
+
+candidate_case generate(std::mt19937& rng, std::size_t iteration) {
+  std::uniform_real_distribution<double> coord(0, 100);
+  std::uniform_int_distribution<int> small(0, 5);
+
+  static const char* kinds[] = {
+    "random", "duplicates", "collinear", "lattice", "identical", "tiny"
+  };
+
+  candidate_case c;
+  c.kind = kinds[iteration % 6];
+
+  std::size_t N = 2 + rng() % 60;
+  if (c.kind == "tiny")
+    N = 2 + rng() % 3;
+
+  for (std::size_t i = 0; i < N; ++i) {
+    double x[3];
+    if (c.kind == "duplicates" && i > 0 && rng() % 2 == 0) {
+      std::size_t j = rng() % i;
+      for (int k = 0; k < 3; ++k)
+        x[k] = c.lab[3*j + k];
+    } else if (c.kind == "collinear") {
+      // Evenly spaced points on a line, many of them equally far apart
+      const double t = double(rng() % 12);
+      x[0] = 10 + 5*t;
+      x[1] = 20 + 2*t;
+      x[2] = 30 - 1*t;
+    } else if (c.kind == "lattice") {
+      for (int k = 0; k < 3; ++k)
+        x[k] = 10.0*small(rng);
+    } else if (c.kind == "identical") {
+      x[0] = 50;
+      x[1] = 0;
+      x[2] = 0;
+    } else {
+      for (int k = 0; k < 3; ++k)
+        x[k] = coord(rng);
+    }
+    c.lab.insert(c.lab.end(), x, x + 3);
+  }
+
+  c.n = 2 + rng() % (N - 1);
+
+  return c;
+}
+
+} // namespace
+
+#ifdef QUALPAL_LIBFUZZER
+
+// Bytes: n, then one color per three bytes
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+  static qualpal::thread_pool pool(2);
+
+  if (size < 7)
+    return 0;
+
+  candidate_case c;
+  c.kind = "fuzzed";
+  std::size_t N = std::min<std::size_t>((size - 1)/3, 64);
+  for (std::size_t i = 0; i < 3*N; ++i)
+    c.lab.push_back(data[1 + i]*(100.0/255));
+  c.n = 2 + data[0] % (N - 1);
+
+  std::string error = check(c, pool);
+  if (error.empty()) {
+    std::vector<double> rgb(c.lab.size());
+    for (std::size_t i = 0; i < rgb.size(); ++i)
+      rgb[i] = data[1 + i]/255.0;
+    error = check_coreset(rgb, 2 + data[0] % 16);
+  }
+
+  if (!error.empty()) {
+    std::fprintf(stderr, "%s\n%s\n", error.c_str(), describe(c).c_str());
+    std::abort();
+  }
+
+  return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+  std::size_t iterations = 2000;
+  unsigned long seed = 1;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--iterations")
+      iterations = std::strtoul(argv[i + 1], 0, 10);
+    else if (arg == "--seed")
+      seed = std::strtoul(argv[i + 1], 0, 10);
+    else {
+      std::fprintf(stderr, "usage: fuzz-farthest-points [--iterations K] [--seed S]\n");
+      return 2;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  qualpal::thread_pool pool(4);
+  std::size_t failures = 0;
+
+  for (unsigned long k = 0; k < 5; ++k) {
+    std::string error = check_ciede2000(seed + k);
+    if (!error.empty()) {
+      failures++;
+      std::fprintf(stderr, "%s\n", error.c_str());
+    }
+  }
+
+  for (std::size_t it = 0; it < iterations; ++it) {
+    candidate_case c = generate(rng, it);
+    std::string error = check(c, pool);
+
+    if (error.empty() && it % 6 == 0) {
+      std::uniform_real_distribution<double> unit(0, 1);
+      std::vector<double> rgb(3*(1 + rng() % 500));
+      for (std::size_t k = 0; k < rgb.size(); ++k)
+        rgb[k] = unit(rng);
+      error = check_coreset(rgb, 2 + rng() % 64);
+    }
+
+    if (!error.empty()) {
+      failures++;
+      std::fprintf(stderr, "iteration %lu: %s\n  %s\n",
+                   static_cast<unsigned long>(it), error.c_str(),
+                   describe(c).c_str());
+      if (failures >= 10)
+        break;
+    }
+
+    if (it % 6 == 3) {
+      error = check_session(rng, pool);
+      if (!error.empty()) {
+        failures++;
+        std::fprintf(stderr, "iteration %lu: session %s\n",
+                     static_cast<unsigned long>(it), error.c_str());
+        if (failures >= 10)
+          break;
+      }
+    }
+  }
+
+  std::printf("%lu cases, %lu failures (seed %lu)\n",
+              static_cast<unsigned long>(iterations),
+              static_cast<unsigned long>(failures), seed);
+
+  return failures > 0;
+}
+
+#endif // QUALPAL_LIBFUZZER
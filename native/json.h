@@ -0,0 +1,241 @@
+// A minimal JSON reader and writer for the native tools: enough for the
+// flat request and response objects of the palette server.
+
+#ifndef QUALPALR_NATIVE_JSON_H
+#define QUALPALR_NATIVE_JSON_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace json {
+
+struct value {
+  enum kind_t { null, boolean, number, string, array, object } kind;
+
+  bool b;
+  double num;
+  std::string str;
+  std::vector<value> items;
+  std::map<std::string, value> members;
+
+  value() : kind(null), b(false), num(0) {}
+
+  bool has(const std::string& key) const {
+    return kind == object && members.count(key) > 0;
+  }
+
+  const value& operator[](const std::string& key) const {
+    std::map<std::string, value>::const_iterator it = members.find(key);
+    if (kind != object || it == members.end())
+      throw std::runtime_error("missing field '" + key + "'");
+    return it->second;
+  }
+
+  double as_number() const {
+    if (kind != number)
+      throw std::runtime_error("expected a number");
+    return num;
+  }
+
+  const std::string& as_string() const {
+    if (kind != string)
+      throw std::runtime_error("expected a string");
+    return str;
+  }
+
+  const std::vector<value>& as_array() const {
+    if (kind != array)
+      throw std::runtime_error("expected an array");
+    return items;
+  }
+};
+
+class parser {
+public:
+  explicit parser(const std::string& text) : s(text), i(0) {}
+
+  value parse() {
+    value v = parse_value();
+    skip_ws();
+    if (i != s.size())
+      fail("trailing characters");
+    return v;
+  }
+
+private:
+  void fail(const char* what) {
+    std::ostringstream msg;
+    msg << "invalid JSON at offset " << i << ": " << what;
+    throw std::runtime_error(msg.str());
+  }
+
+  void skip_ws() {
+    while (i < s.size() &&
+           (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r'))
+      i++;
+  }
+
+  bool consume(const char* word) {
+    std::size_t n = std::string(word).size();
+    if (s.compare(i, n, word) == 0) {
+      i += n;
+      return true;
+    }
+    return false;
+  }
+
+  value parse_value() {
+    skip_ws();
+    if (i >= s.size())
+      fail("unexpected end of input");
+
+    value v;
+    char c = s[i];
+
+    if (c == '{') {
+      v.kind = value::object;
+      i++;
+      skip_ws();
+      if (i < s.size() && s[i] == '}') {
+        i++;
+        return v;
+      }
+      for (;;) {
+        skip_ws();
+        std::string key = parse_string();
+        skip_ws();
+        if (i >= s.size() || s[i] != ':')
+          fail("expected ':'");
+        i++;
+        v.members[key] = parse_value();
+        skip_ws();
+        if (i < s.size() && s[i] == ',') {
+          i++;
+        } else if (i < s.size() && s[i] == '}') {
+          i++;
+          return v;
+        } else {
+          fail("expected ',' or '}'");
+        }
+      }
+    } else if (c == '[') {
+      v.kind = value::array;
+      i++;
+      skip_ws();
+      if (i < s.size() && s[i] == ']') {
+        i++;
+        return v;
+      }
+      for (;;) {
+        v.items.push_back(parse_value());
+        skip_ws();
+        if (i < s.size() && s[i] == ',') {
+          i++;
+        } else if (i < s.size() && s[i] == ']') {
+          i++;
+          return v;
+        } else {
+          fail("expected ',' or ']'");
+        }
+      }
+    } else if (c == '"') {
+      v.kind = value::string;
+      v.str = parse_string();
+    } else if (consume("true")) {
+      v.kind = value::boolean;
+      v.b = true;
+    } else if (consume("false")) {
+      v.kind = value::boolean;
+    } else if (consume("null")) {
+      v.kind = value::null;
+    } else {
+      const char* begin = s.c_str() + i;
+      char* end = 0;
+      v.kind = value::number;
+      v.num = std::strtod(begin, &end);
+      if (end == begin)
+        fail("unexpected character");
+      i += end - begin;
+    }
+
+    return v;
+  }
+
+  std::string parse_string() {
+    if (i >= s.size() || s[i] != '"')
+      fail("expected a string");
+    i++;
+    std::string out;
+    while (i < s.size() && s[i] != '"') {
+      char c = s[i++];
+      if (c == '\\') {
+        if (i >= s.size())
+          fail("unterminated escape");
+        char e = s[i++];
+        switch (e) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'u':
+          // Only ASCII escapes are needed here
+          if (i + 4 > s.size())
+            fail("short unicode escape");
+          out += static_cast<char>(std::strtol(s.substr(i, 4).c_str(), 0, 16));
+          i += 4;
+          break;
+        default: out += e;
+        }
+      } else {
+        out += c;
+      }
+    }
+    if (i >= s.size())
+      fail("unterminated string");
+    i++;
+    return out;
+  }
+
+  const std::string& s;
+  std::size_t i;
+};
+
+inline value parse(const std::string& text) {
+  return parser(text).parse();
+}
+
+inline std::string quote(const std::string& s) {
+  std::string out("\"");
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+inline std::string number(double x) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.10g", x);
+  return buf;
+}
+
+} // namespace json
+
+#endif // QUALPALR_NATIVE_JSON_H
@@ -0,0 +1,251 @@
+// qualpal: generate qualitative palettes from the command line.
+//
+// Candidate colors are read as a stream from a file or standard input (hex
+// colors, CSV rows of 0-255 sRGB components, raw 8-bit RGB triplets, or the
+// pixels of binary PPM and PAM images) and reduced on the fly by a grid
+// coreset, so inputs can be far larger than memory. Without input, colors are
+// sampled from a predefined color space instead. The palette is written as
+// hex colors, CSV, or JSON.
+//
+// Usage: qualpal -n N [options] [FILE]
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "coreset.h"
+#include "engine.h"
+#include "image.h"
+#include "json.h"
+#include "request.h"
+
+namespace {
+
+const char* usage_text =
+  "usage: qualpal -n N [options] [FILE]\n"
+  "\n"
+  "Reads candidate colors from FILE (or standard input with '-').\n"
+  "\n"
+  "  -n N                number of colors in the palette\n"
+  "  --colorspace NAME   sample candidates from a predefined color space\n"
+  "                      instead of reading them (default: pretty)\n"
+  "  --input-format F    hex, csv, raw, ppm, pam, or image (PPM or PAM,\n"
+  "                      detected from the header) (default: hex)\n"
+  "  --output-format F   hex, csv, or json (default: hex)\n"
+  "  --max-points K      size of the coreset of the input (default: 4000)\n"
+  "  --threads T         worker threads (default: hardware concurrency)\n"
+  "  --time-budget S     stop the search after S seconds\n"
+  "  --metric M          din99d or euclidean (default: din99d)\n"
+  "  --cvd TYPE          protan, deutan, or tritan\n"
+  "  --cvd-severity S    severity in [0, 1] (default: 1 with --cvd)\n"
+  "  --mode M            scan, pruned, heap, or local (default: heap)\n";
+
+void usage() {
+  std::cerr << usage_text;
+  std::exit(2);
+}
+
+void fail(const std::string& message) {
+  std::cerr << "qualpal: " << message << "\n";
+  std::exit(1);
+}
+
+// Feed colors from a stream to the coreset, one token or triplet at a time
+void read_hex(std::istream& in, qualpal::grid_coreset& coreset) {
+  std::string token;
+  while (in >> token) {
+    double rgb[3];
+    if (!qualpal::hex_rgb(token, rgb))
+      fail("invalid hex color '" + token + "'");
+    coreset.add(rgb);
+  }
+}
+
+void read_csv(std::istream& in, qualpal::grid_coreset& coreset) {
+  std::string line;
+  std::size_t line_no = 0;
+
+  while (std::getline(in, line)) {
+    line_no++;
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    // Skip a header
+    std::size_t first = line.find_first_not_of(" \t");
+    if (line_no == 1 && !std::isdigit(static_cast<unsigned char>(line[first])) &&
+        line[first] != '.')
+      continue;
+
+    std::istringstream row(line);
+    std::string field;
+    double rgb[3];
+    int k = 0;
+    for (; k < 3 && std::getline(row, field, ','); ++k) {
+      char* end;
+      rgb[k] = std::strtod(field.c_str(), &end)/255;
+      if (end == field.c_str() || !(rgb[k] >= 0 && rgb[k] <= 1))
+        break;
+    }
+    if (k != 3) {
+      std::ostringstream msg;
+      msg << "line " << line_no << " is not a row of three 0-255 values";
+      fail(msg.str());
+    }
+    coreset.add(rgb);
+  }
+}
+
+// Raw RGB and images, in chunks and with repeated colors dropped early
+void read_pixels(std::istream& in,
+                 qualpal::image_format format,
+                 qualpal::grid_coreset& coreset) {
+  try {
+    qualpal::image_info info = qualpal::read_image(
+      in, format, [&coreset](const double* rgb) { coreset.add(rgb); });
+    if (format == qualpal::image_auto && info.format == qualpal::image_raw)
+      fail("not a PPM or PAM image");
+  } catch (const std::runtime_error& e) {
+    fail(e.what());
+  }
+}
+
+void write_palette(const qualpal::palette_result& res,
+                   const std::string& format) {
+  if (format == "hex") {
+    for (std::size_t i = 0; i < res.hex.size(); ++i)
+      std::cout << res.hex[i] << "\n";
+  } else if (format == "csv") {
+    std::cout << "hex,r,g,b\n";
+    for (std::size_t i = 0; i < res.hex.size(); ++i) {
+      double rgb[3];
+      qualpal::hex_rgb(res.hex[i], rgb);
+      std::cout << res.hex[i];
+      for (int k = 0; k < 3; ++k)
+        std::cout << "," << static_cast<int>(rgb[k]*255 + 0.5);
+      std::cout << "\n";
+    }
+  } else {
+    std::cout << "{" << qualpal::format_result(res) << "}\n";
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  qualpal::palette_request req;
+  std::string input, in_format = "hex", out_format = "hex";
+  std::size_t n_threads = 0, max_points = 4000;
+  bool cvd_given = false, severity_given = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg == "-h" || arg == "--help") {
+      std::cout << usage_text;
+      return 0;
+    }
+
+    if (arg.size() > 1 && arg[0] == '-') {
+      if (i + 1 >= argc)
+        usage();
+      std::string val = argv[++i];
+
+      if (arg == "-n")
+        req.n = std::strtoul(val.c_str(), 0, 10);
+      else if (arg == "--colorspace") {
+        if (!qualpal::predefined_colorspace(val, req.box))
+          fail("unknown color space '" + val + "'");
+      } else if (arg == "--input-format")
+        in_format = val;
+      else if (arg == "--output-format")
+        out_format = val;
+      else if (arg == "--max-points")
+        max_points = std::strtoul(val.c_str(), 0, 10);
+      else if (arg == "--threads")
+        n_threads = std::strtoul(val.c_str(), 0, 10);
+      else if (arg == "--time-budget")
+        req.search.time_budget = std::atof(val.c_str());
+      else if (arg == "--metric") {
+        if (!qualpal::parse_metric(val, req.metric))
+          fail("unknown metric '" + val + "'");
+      } else if (arg == "--cvd") {
+        if (!qualpal::parse_cvd(val, req.cvd))
+          fail("unknown cvd '" + val + "'");
+        cvd_given = true;
+      } else if (arg == "--cvd-severity") {
+        req.cvd_severity = std::atof(val.c_str());
+        severity_given = true;
+      } else if (arg == "--mode") {
+        try {
+          req.search.strategy = qualpal::parse_strategy(val);
+        } catch (const std::exception& e) {
+          fail(e.what());
+        }
+      } else {
+        usage();
+      }
+    } else {
+      input = arg;
+    }
+  }
+
+  if (cvd_given && !severity_given)
+    req.cvd_severity = 1;
+
+  qualpal::image_format image_format = qualpal::image_raw;
+  if (in_format == "image")
+    image_format = qualpal::image_auto;
+  else if (in_format != "hex" && in_format != "csv" &&
+           (in_format == "auto" ||
+            !qualpal::parse_image_format(in_format, image_format)))
+    fail("unknown input format '" + in_format + "'");
+  if (out_format != "hex" && out_format != "csv" && out_format != "json")
+    fail("unknown output format '" + out_format + "'");
+  if (max_points < 2)
+    fail("--max-points must be at least 2");
+
+  if (!input.empty()) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (input != "-") {
+      file.open(input.c_str(), std::ios::binary);
+      if (!file)
+        fail("cannot open '" + input + "'");
+      in = &file;
+    }
+
+    qualpal::grid_coreset coreset(max_points);
+    if (in_format == "hex")
+      read_hex(*in, coreset);
+    else if (in_format == "csv")
+      read_csv(*in, coreset);
+    else
+      read_pixels(*in, image_format, coreset);
+
+    if (coreset.cell_width() > 0)
+      std::cerr << "qualpal: reduced " << coreset.count() << " colors to "
+                << coreset.size() << " (cell width "
+                << coreset.cell_width() << ")\n";
+
+    req.use_box = false;
+    req.candidates = coreset.rgb();
+  }
+
+  try {
+    qualpal::engine engine(n_threads, 0);
+    qualpal::palette_result res = engine.generate(req);
+    if (res.diagnostics.timed_out)
+      std::cerr << "qualpal: time budget exceeded; the palette may not be "
+                   "optimal\n";
+    write_palette(res, out_format);
+  } catch (const std::exception& e) {
+    fail(e.what());
+  }
+
+  return 0;
+}
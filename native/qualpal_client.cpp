@@ -0,0 +1,192 @@
+// qualpal-client: talk to qualpald.
+//
+// Without options other than --socket, request lines are read from standard
+// input and the replies are written to standard output. With --load, the
+// client instead opens several connections that send a mix of requests
+// concurrently and reports throughput and latency percentiles.
+//
+// Usage: qualpal-client [--socket PATH]
+//        qualpal-client --load [--connections C] [--requests R] [--socket PATH]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+int connect_to(const std::string& path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    std::perror("qualpal-client");
+    std::exit(1);
+  }
+  return fd;
+}
+
+// One request line out, one reply line back
+class connection {
+public:
+  explicit connection(const std::string& path) : fd(connect_to(path)) {}
+  ~connection() { close(fd); }
+
+  std::string roundtrip(const std::string& line) {
+    std::string out = line + "\n";
+    std::size_t sent = 0;
+    while (sent < out.size()) {
+      ssize_t k = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+      if (k <= 0)
+        return "";
+      sent += k;
+    }
+
+    std::size_t eol;
+    while ((eol = buffer.find('\n')) == std::string::npos) {
+      char chunk[4096];
+      ssize_t k = recv(fd, chunk, sizeof(chunk), 0);
+      if (k <= 0)
+        return "";
+      buffer.append(chunk, k);
+    }
+    std::string reply = buffer.substr(0, eol);
+    buffer.erase(0, eol + 1);
+    return reply;
+  }
+
+private:
+  connection(const connection&);
+  connection& operator=(const connection&);
+
+  int fd;
+  std::string buffer;
+};
+
+// A small mix of typical requests
+std::string make_request(std::size_t k) {
+  static const char* spaces[] = {
+    "\"pretty\"", "\"pretty_dark\"", "\"rainbow\"", "\"pastels\"",
+    "{\"h\":[-200,120],\"s\":[0.3,0.8],\"l\":[0.4,0.9]}"
+  };
+  char buf[256];
+  std::snprintf(buf, sizeof(buf),
+                "{\"id\":%lu,\"n\":%lu,\"colorspace\":%s%s}",
+                static_cast<unsigned long>(k),
+                static_cast<unsigned long>(3 + k % 10),
+                spaces[k % 5],
+                k % 7 == 0 ? ",\"cvd\":\"deutan\",\"cvd_severity\":0.7" : "");
+  return buf;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  std::size_t i = static_cast<std::size_t>(p*(sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+int load(const std::string& path, std::size_t connections, std::size_t requests) {
+  std::vector<double> latencies;
+  std::mutex mutex;
+  std::size_t errors = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (std::size_t c = 0; c < connections; ++c) {
+    threads.push_back(std::thread([&, c]() {
+      connection conn(path);
+      std::vector<double> local;
+      std::size_t failed = 0;
+      for (std::size_t r = 0; r < requests; ++r) {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        std::string reply = conn.roundtrip(make_request(c*requests + r));
+        local.push_back(std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - t0).count());
+        if (reply.empty() || reply.find("\"error\"") != std::string::npos)
+          failed++;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      latencies.insert(latencies.end(), local.begin(), local.end());
+      errors += failed;
+    }));
+  }
+  for (std::size_t c = 0; c < threads.size(); ++c)
+    threads[c].join();
+
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  std::sort(latencies.begin(), latencies.end());
+  std::printf("requests:   %lu (%lu errors)\n",
+              static_cast<unsigned long>(latencies.size()),
+              static_cast<unsigned long>(errors));
+  std::printf("throughput: %.1f requests/s\n", latencies.size()/seconds);
+  std::printf("latency:    p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+              percentile(latencies, 0.5), percentile(latencies, 0.9),
+              percentile(latencies, 0.99),
+              latencies.empty() ? 0.0 : latencies.back());
+
+  return errors > 0;
+}
+
+void usage() {
+  std::cerr << "usage: qualpal-client [--socket PATH] [--load "
+               "[--connections C] [--requests R]]\n";
+  std::exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string path = "/tmp/qualpald.sock";
+  bool load_test = false;
+  std::size_t connections = 8, requests = 100;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--load") {
+      load_test = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+      usage();
+    if (arg == "--socket")
+      path = argv[++i];
+    else if (arg == "--connections")
+      connections = std::strtoul(argv[++i], 0, 10);
+    else if (arg == "--requests")
+      requests = std::strtoul(argv[++i], 0, 10);
+    else
+      usage();
+  }
+
+  if (load_test)
+    return load(path, connections, requests);
+
+  connection conn(path);
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line.empty())
+      continue;
+    std::string reply = conn.roundtrip(line);
+    if (reply.empty())
+      return 1;
+    std::cout << reply << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+// qualpal-loadgen: replay a mix of palette requests against the native
+// engine from many concurrent callers and report tail latency, throughput,
+// and peak memory, as well as how many heap allocations a request makes on
+// the calling thread.
+//
+// The mix combines three kinds of requests, weighted by --mix:
+//
+//   preset   small palettes (2-10 colors) from the predefined color spaces,
+//            with occasional color vision deficiency adaptation
+//   custom   palettes from large explicit candidate sets (--custom-size
+//            colors each, drawn from --custom-sets distinct sets)
+//   autopal  severity searches as in autopal(), which issue a series of
+//            requests with varying color vision deficiency severity
+//
+// Usage: qualpal-loadgen [--callers C] [--requests R | --duration S]
+//                        [--mix preset=70,custom=25,autopal=5]
+//                        [--custom-size N] [--custom-sets K]
+//                        [--threads T] [--cache K] [--seed S]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "engine.h"
+
+namespace {
+
+thread_local std::size_t heap_allocations = 0;
+
+} // namespace
+
+// Replacing the global allocation functions is fine, whatever GCC thinks of
+// pairing them with malloc() and free()
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Count every allocation made through operator new on the current thread
+void* operator new(std::size_t size) {
+  heap_allocations++;
+  void* p = std::malloc(size > 0 ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+enum request_kind { kind_preset, kind_custom, kind_autopal, n_kinds };
+
+const char* kind_names[n_kinds] = {"preset", "custom", "autopal"};
+
+struct options {
+  std::size_t callers, requests, custom_size, custom_sets, threads, cache;
+  double duration;
+  double weights[n_kinds];
+  unsigned long seed;
+
+  options()
+    : callers(8),
+      requests(200),
+      custom_size(1500),
+      custom_sets(4),
+      threads(0),
+      cache(16),
+      duration(0),
+      seed(1) {
+    weights[kind_preset] = 70;
+    weights[kind_custom] = 25;
+    weights[kind_autopal] = 5;
+  }
+};
+
+void usage() {
+  std::cerr << "usage: qualpal-loadgen [--callers C] [--requests R | --duration S]\n"
+               "                       [--mix preset=70,custom=25,autopal=5]\n"
+               "                       [--custom-size N] [--custom-sets K]\n"
+               "                       [--threads T] [--cache K] [--seed S]\n";
+  std::exit(2);
+}
+
+void parse_mix(const std::string& mix, double* weights) {
+  std::fill(weights, weights + n_kinds, 0.0);
+  std::istringstream in(mix);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    std::size_t eq = item.find('=');
+    if (eq == std::string::npos)
+      usage();
+    std::string name = item.substr(0, eq);
+    int k = 0;
+    while (k < n_kinds && name != kind_names[k])
+      ++k;
+    if (k == n_kinds)
+      usage();
+    weights[k] = std::atof(item.c_str() + eq + 1);
+  }
+}
+
+// Latencies (milliseconds) of one caller, by kind
+struct caller_log {
+  std::vector<double> latencies[n_kinds];
+  std::vector<std::size_t> allocations[n_kinds];
+  std::size_t errors;
+
+  caller_log() : errors(0) {}
+};
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  std::size_t rank = static_cast<std::size_t>(std::ceil(p*sorted.size()));
+  return sorted[std::max<std::size_t>(rank, 1) - 1];
+}
+
+void print_row(const char* name,
+               std::vector<double> x,
+               std::vector<std::size_t> allocs) {
+  std::sort(x.begin(), x.end());
+  std::sort(allocs.begin(), allocs.end());
+  std::printf("%-8s %8lu %10.3f %10.3f %10.3f %10.3f %8lu %8lu\n", name,
+              static_cast<unsigned long>(x.size()), percentile(x, 0.5),
+              percentile(x, 0.99), percentile(x, 0.999),
+              x.empty() ? 0.0 : x.back(),
+              static_cast<unsigned long>(allocs.empty() ? 0 : allocs[allocs.size()/2]),
+              static_cast<unsigned long>(allocs.empty() ? 0 : allocs.back()));
+}
+
+double peak_rss_mb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss/1024.0;  // kilobytes on Linux
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  options opt;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char* val = argv[++i];
+
+    if (arg == "--callers")
+      opt.callers = std::strtoul(val, 0, 10);
+    else if (arg == "--requests")
+      opt.requests = std::strtoul(val, 0, 10);
+    else if (arg == "--duration")
+      opt.duration = std::atof(val);
+    else if (arg == "--mix")
+      parse_mix(val, opt.weights);
+    else if (arg == "--custom-size")
+      opt.custom_size = std::strtoul(val, 0, 10);
+    else if (arg == "--custom-sets")
+      opt.custom_sets = std::strtoul(val, 0, 10);
+    else if (arg == "--threads")
+      opt.threads = std::strtoul(val, 0, 10);
+    else if (arg == "--cache")
+      opt.cache = std::strtoul(val, 0, 10);
+    else if (arg == "--seed")
+      opt.seed = std::strtoul(val, 0, 10);
+    else
+      usage();
+  }
+
+  if (opt.callers == 0 || opt.custom_sets == 0 || opt.custom_size < 10)
+    usage();
+
+  // Large explicit candidate sets, shared by all callers
+  std::vector<std::vector<double> > custom(opt.custom_sets);
+  {
+    std::mt19937 rng(opt.seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    for (std::size_t s = 0; s < custom.size(); ++s) {
+      custom[s].resize(3*opt.custom_size);
+      for (std::size_t k = 0; k < custom[s].size(); ++k)
+        custom[s][k] = unit(rng);
+    }
+  }
+
+  static const char* spaces[] = {"pretty", "pretty_dark", "rainbow", "pastels"};
+  static const qualpal::cvd_type cvds[] = {
+    qualpal::cvd_protan, qualpal::cvd_deutan, qualpal::cvd_tritan
+  };
+
+  qualpal::engine engine(opt.threads, opt.cache);
+  std::vector<caller_log> logs(opt.callers);
+
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point stop = start +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(opt.duration));
+
+  std::vector<std::thread> callers;
+  for (std::size_t c = 0; c < opt.callers; ++c) {
+    callers.push_back(std::thread([&, c]() {
+      std::mt19937 rng(opt.seed + 1 + c);
+      std::discrete_distribution<int> pick(opt.weights, opt.weights + n_kinds);
+      caller_log& log = logs[c];
+
+      for (std::size_t r = 0;; ++r) {
+        if (opt.duration > 0 ? std::chrono::steady_clock::now() >= stop
+                             : r >= opt.requests)
+          break;
+
+        const int kind = pick(rng);
+        qualpal::palette_request req;
+        double target = 0;
+
+        if (kind == kind_preset) {
+          req.n = 2 + rng() % 9;
+          qualpal::predefined_colorspace(spaces[rng() % 4], req.box);
+          if (rng() % 5 == 0) {
+            req.cvd = cvds[rng() % 3];
+            req.cvd_severity = 0.5*(1 + rng() % 2);
+          }
+        } else if (kind == kind_custom) {
+          req.n = 5 + rng() % 20;
+          req.use_box = false;
+          req.candidates = custom[rng() % custom.size()];
+        } else {
+          req.n = 3 + rng() % 6;
+          req.cvd = cvds[rng() % 3];
+          target = 15 + rng() % 11;
+        }
+
+        const std::size_t allocations = heap_allocations;
+        const std::chrono::steady_clock::time_point t0 =
+          std::chrono::steady_clock::now();
+        try {
+          if (kind == kind_autopal)
+            engine.autopal(req, target);
+          else
+            engine.generate(req);
+        } catch (const std::exception&) {
+          log.errors++;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - t0).count();
+        log.allocations[kind].push_back(heap_allocations - allocations);
+        log.latencies[kind].push_back(ms);
+      }
+    }));
+  }
+  for (std::size_t c = 0; c < callers.size(); ++c)
+    callers[c].join();
+
+  const double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  std::vector<double> all, by_kind[n_kinds];
+  std::vector<std::size_t> all_allocs, allocs_by_kind[n_kinds];
+  std::size_t errors = 0;
+  for (std::size_t c = 0; c < logs.size(); ++c) {
+    for (int k = 0; k < n_kinds; ++k) {
+      by_kind[k].insert(by_kind[k].end(), logs[c].latencies[k].begin(),
+                        logs[c].latencies[k].end());
+      all.insert(all.end(), logs[c].latencies[k].begin(),
+                 logs[c].latencies[k].end());
+      allocs_by_kind[k].insert(allocs_by_kind[k].end(),
+                               logs[c].allocations[k].begin(),
+                               logs[c].allocations[k].end());
+      all_allocs.insert(all_allocs.end(), logs[c].allocations[k].begin(),
+                        logs[c].allocations[k].end());
+    }
+    errors += logs[c].errors;
+  }
+
+  std::printf("%-8s %8s %10s %10s %10s %10s %8s %8s\n", "kind", "requests",
+              "p50 ms", "p99 ms", "p99.9 ms", "max ms", "allocs", "max");
+  for (int k = 0; k < n_kinds; ++k)
+    if (!by_kind[k].empty())
+      print_row(kind_names[k], by_kind[k], allocs_by_kind[k]);
+  print_row("all", all, all_allocs);
+
+  const qualpal::candidate_cache& cache = engine.artifacts();
+  std::printf("\nthroughput: %.1f requests/s (%lu callers, %lu threads, %.2f s)\n",
+              all.size()/seconds, static_cast<unsigned long>(opt.callers),
+              static_cast<unsigned long>(engine.pool().size()), seconds);
+  std::printf("cache:      %lu hits, %lu misses\n",
+              static_cast<unsigned long>(cache.hit_count()),
+              static_cast<unsigned long>(cache.miss_count()));
+  std::printf("peak RSS:   %.1f MB\n", peak_rss_mb());
+  if (errors > 0)
+    std::printf("errors:     %lu\n", static_cast<unsigned long>(errors));
+
+  return errors > 0;
+}
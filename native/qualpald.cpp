@@ -0,0 +1,190 @@
+// qualpald: a long-running palette server.
+//
+// Listens on a Unix domain socket for newline-delimited JSON requests (see
+// request.h) and answers each with a single line of JSON, for instance
+//
+//   {"id":1,"hex":["#..."],"min_de":21.3,"cache_hit":true,"elapsed_ms":0.4}
+//
+// or {"id":1,"error":"..."}. Requests from all connections run on one
+// shared thread pool, and candidate colors and distance matrices are kept
+// warm across requests.
+//
+// {"stats":true} returns the cumulative statistics of the server (calls,
+// cache hits, and latency quantiles per phase) instead of a palette, for
+// monitoring; {"stats":true,"reset":true} also starts them over.
+//
+// Requests for more than --max-points candidate colors (4000 by default)
+// are rejected, since their distance matrices would grow without bound.
+//
+// Usage: qualpald [--socket PATH] [--threads N] [--cache N] [--max-points K]
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "json.h"
+#include "request.h"
+
+namespace {
+
+const char* socket_path = "/tmp/qualpald.sock";
+
+void on_signal(int) {
+  unlink(socket_path);
+  _exit(0);
+}
+
+bool write_all(int fd, const std::string& data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t k = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (k <= 0)
+      return false;
+    sent += k;
+  }
+  return true;
+}
+
+std::string handle(qualpal::engine& engine, const std::string& line) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::string id;
+
+  try {
+    json::value v = json::parse(line);
+    id = qualpal::format_id(v);
+
+    if (v.has("stats") && v["stats"].kind == json::value::boolean &&
+        v["stats"].b) {
+      std::string out = "{" + id + qualpal::format_stats(qualpal::stats_collect());
+      if (v.has("reset") && v["reset"].kind == json::value::boolean &&
+          v["reset"].b)
+        qualpal::stats_reset();
+      return out + "}\n";
+    }
+
+    qualpal::palette_request req = qualpal::parse_request(v);
+    const bool adapt = v.has("target");
+    const double target = adapt ? v["target"].as_number() : 0;
+
+    // Run the request itself on the shared pool
+    std::shared_ptr<std::promise<qualpal::palette_result> > done =
+      std::make_shared<std::promise<qualpal::palette_result> >();
+    engine.pool().submit([&engine, req, adapt, target, done]() {
+      try {
+        done->set_value(adapt ? engine.autopal(req, target)
+                              : engine.generate(req));
+      } catch (...) {
+        done->set_exception(std::current_exception());
+      }
+    });
+    qualpal::palette_result res = done->get_future().get();
+
+    double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+    return "{" + id + qualpal::format_result(res) +
+      ",\"elapsed_ms\":" + json::number(ms) + "}\n";
+  } catch (const std::exception& e) {
+    return "{" + id + "\"error\":" + json::quote(e.what()) + "}\n";
+  }
+}
+
+void serve(qualpal::engine& engine, int fd) {
+  std::string buffer;
+  char chunk[4096];
+
+  for (;;) {
+    ssize_t k = recv(fd, chunk, sizeof(chunk), 0);
+    if (k <= 0)
+      break;
+    buffer.append(chunk, k);
+
+    std::size_t eol;
+    while ((eol = buffer.find('\n')) != std::string::npos) {
+      std::string line = buffer.substr(0, eol);
+      buffer.erase(0, eol + 1);
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+      if (!write_all(fd, handle(engine, line))) {
+        close(fd);
+        return;
+      }
+    }
+  }
+
+  close(fd);
+}
+
+void usage() {
+  std::cerr << "usage: qualpald [--socket PATH] [--threads N] [--cache N] "
+               "[--max-points K]\n";
+  std::exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t n_threads = 0, cache = 16, max_points = 4000;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    if (arg == "--socket")
+      socket_path = argv[++i];
+    else if (arg == "--threads")
+      n_threads = std::strtoul(argv[++i], 0, 10);
+    else if (arg == "--cache")
+      cache = std::strtoul(argv[++i], 0, 10);
+    else if (arg == "--max-points")
+      max_points = std::strtoul(argv[++i], 0, 10);
+    else
+      usage();
+  }
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(socket_path) >= sizeof(addr.sun_path)) {
+    std::cerr << "qualpald: socket path too long\n";
+    return 1;
+  }
+  std::strcpy(addr.sun_path, socket_path);
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if (server < 0 ||
+      bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(server, 64) < 0) {
+    std::perror("qualpald");
+    return 1;
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  qualpal::engine engine(n_threads, cache);
+  engine.limit_candidates(max_points);
+
+  std::cerr << "qualpald: listening on " << socket_path << " with "
+            << engine.pool().size() << " threads\n";
+
+  for (;;) {
+    int fd = accept(server, 0, 0);
+    if (fd < 0)
+      continue;
+    std::thread(serve, std::ref(engine), fd).detach();
+  }
+}
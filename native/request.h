@@ -0,0 +1,172 @@
+// Translation between JSON palette requests and the native engine, shared
+// by the native tools.
+//
+// A request is an object such as
+//
+//   {"id": 1, "n": 5, "colorspace": "pretty", "cvd": "deutan",
+//    "cvd_severity": 0.5, "fixed": ["#FF0000"]}
+//
+// where "colorspace" is either the name of a predefined color space, an
+// object with two-element "h", "s", and "l" ranges, or an array of hex
+// colors to choose from. Everything except "n" is optional.
+
+#ifndef QUALPALR_NATIVE_REQUEST_H
+#define QUALPALR_NATIVE_REQUEST_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "json.h"
+#include "stats.h"
+
+namespace qualpal {
+
+inline void read_range(const json::value& v, double* range) {
+  const std::vector<json::value>& items = v.as_array();
+  if (items.size() != 2)
+    throw std::invalid_argument("ranges must have two elements");
+  range[0] = std::min(items[0].as_number(), items[1].as_number());
+  range[1] = std::max(items[0].as_number(), items[1].as_number());
+}
+
+inline void read_hex_colors(const json::value& v, std::vector<double>& rgb) {
+  const std::vector<json::value>& items = v.as_array();
+  for (std::size_t i = 0; i < items.size(); ++i) {
+    double c[3];
+    if (!hex_rgb(items[i].as_string(), c))
+      throw std::invalid_argument("invalid hex color '" +
+                                  items[i].as_string() + "'");
+    rgb.insert(rgb.end(), c, c + 3);
+  }
+}
+
+inline swap_strategy parse_strategy(const std::string& name) {
+  if (name == "scan")
+    return swap_scan;
+  if (name == "pruned")
+    return swap_pruned;
+  if (name == "heap")
+    return swap_heap;
+  if (name == "local")
+    return swap_local;
+  throw std::invalid_argument("unknown strategy '" + name + "'");
+}
+
+// A whole number in [lo, hi], checked as a double before it is converted
+inline std::size_t read_count(const json::value& v, double lo, double hi,
+                              const char* error) {
+  const double x = v.as_number();
+  if (!(x >= lo && x <= hi) || x != std::floor(x))
+    throw std::invalid_argument(error);
+  return static_cast<std::size_t>(x);
+}
+
+inline palette_request parse_request(const json::value& v) {
+  palette_request req;
+
+  if (v.kind != json::value::object)
+    throw std::invalid_argument("requests must be JSON objects");
+
+  req.n = read_count(v["n"], 2, max_candidates,
+                     "n must be a count from 2 to 65535");
+
+  if (v.has("colorspace")) {
+    const json::value& cs = v["colorspace"];
+    if (cs.kind == json::value::string) {
+      if (!predefined_colorspace(cs.str, req.box))
+        throw std::invalid_argument("unknown color space '" + cs.str + "'");
+    } else if (cs.kind == json::value::object) {
+      read_range(cs["h"], req.box.h);
+      read_range(cs["s"], req.box.s);
+      read_range(cs["l"], req.box.l);
+    } else {
+      req.use_box = false;
+      read_hex_colors(cs, req.candidates);
+    }
+  }
+
+  if (v.has("n_points"))
+    req.n_points = read_count(v["n_points"], 2, max_candidates,
+                              "n_points must be a count from 2 to 65535");
+
+  if (v.has("cvd") && !parse_cvd(v["cvd"].as_string(), req.cvd))
+    throw std::invalid_argument("unknown cvd '" + v["cvd"].as_string() + "'");
+
+  if (v.has("cvd_severity"))
+    req.cvd_severity = v["cvd_severity"].as_number();
+
+  if (v.has("fixed"))
+    read_hex_colors(v["fixed"], req.fixed);
+
+  if (v.has("metric") && !parse_metric(v["metric"].as_string(), req.metric))
+    throw std::invalid_argument("unknown metric '" +
+                                v["metric"].as_string() + "'");
+
+  if (v.has("time_budget"))
+    req.search.time_budget = v["time_budget"].as_number();
+
+  if (v.has("strategy"))
+    req.search.strategy = parse_strategy(v["strategy"].as_string());
+
+  if (v.has("neighbors"))
+    req.search.n_neighbors = read_count(v["neighbors"], 1, max_candidates,
+                                        "neighbors must be a count from 1 "
+                                        "to 65535");
+
+  return req;
+}
+
+// Echo request ids back as given (numbers or strings)
+inline std::string format_id(const json::value& request) {
+  if (!request.has("id"))
+    return "";
+  const json::value& id = request["id"];
+  if (id.kind == json::value::number)
+    return "\"id\":" + json::number(id.num) + ",";
+  if (id.kind == json::value::string)
+    return "\"id\":" + json::quote(id.str) + ",";
+  return "";
+}
+
+inline std::string format_result(const palette_result& res) {
+  std::string out = "\"hex\":[";
+  for (std::size_t i = 0; i < res.hex.size(); ++i)
+    out += (i > 0 ? "," : "") + json::quote(res.hex[i]);
+  out += "],\"min_de\":" + json::number(res.min_de);
+  out += ",\"cache_hit\":";
+  out += res.cache_hit ? "true" : "false";
+  if (res.cvd_severity > 0)
+    out += ",\"cvd_severity\":" + json::number(res.cvd_severity);
+  if (res.diagnostics.timed_out)
+    out += ",\"timed_out\":true";
+  return out;
+}
+
+// Cumulative statistics, with latencies in milliseconds
+inline std::string format_stats(const stats_snapshot& stats) {
+  std::string out = "\"counters\":{";
+  for (int k = 0; k < stats_n_counters; ++k)
+    out += std::string(k > 0 ? "," : "") + json::quote(stats_counter_name(k)) +
+      ":" + json::number(double(stats.counters[k]));
+
+  out += "},\"phases\":{";
+  for (int p = 0; p < stats_n_phases; ++p) {
+    const stats_histogram& h = stats.phases[p];
+    out += std::string(p > 0 ? "," : "") + json::quote(stats_phase_name(p)) +
+      ":{\"count\":" + json::number(double(h.count)) +
+      ",\"mean_ms\":" + json::number(h.mean_ns()/1e6) +
+      ",\"p50_ms\":" + json::number(h.quantile_ns(0.5)/1e6) +
+      ",\"p99_ms\":" + json::number(h.quantile_ns(0.99)/1e6) +
+      ",\"p999_ms\":" + json::number(h.quantile_ns(0.999)/1e6) +
+      ",\"max_ms\":" + json::number(double(h.max_ns)/1e6) + "}";
+  }
+  return out + "}";
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_NATIVE_REQUEST_H
@@ -0,0 +1,170 @@
+// Concurrency stress test of the native core.
+//
+// Many caller threads generate palettes at once against shared, immutable
+// state: one candidate set that every caller searches with select_palette(),
+// one engine (with its thread pool and candidate cache) that callers send
+// whole requests to, and the same pool for force-directed palettes, while
+// the cumulative statistics are collected now and then. Every result must
+// match the one computed serially beforehand. Built with
+// -fsanitize=thread (make stress-engine-tsan), ThreadSanitizer additionally
+// reports any data race among the callers, the pool, and the caches.
+//
+// Usage: stress-engine [--callers C] [--requests R] [--seed S]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.h"
+#include "repulsion.h"
+
+namespace {
+
+const char* const spaces[] = {"pretty", "pretty_dark", "rainbow", "pastels"};
+const qualpal::swap_strategy strategies[] = {qualpal::swap_scan,
+                                             qualpal::swap_pruned,
+                                             qualpal::swap_heap};
+const std::size_t n_max = 30;
+
+// Searches on the shared candidate set, by n and strategy
+struct search_reference {
+  std::vector<std::vector<std::size_t> > indices[3];
+};
+
+// Whole requests to the shared engine, by color space and n
+qualpal::palette_request engine_request(std::size_t space, std::size_t n) {
+  qualpal::palette_request req;
+  req.n = n;
+  req.n_points = 400;
+  qualpal::predefined_colorspace(spaces[space], req.box);
+  if (space % 2 == 1) {
+    req.cvd = qualpal::cvd_deutan;
+    req.cvd_severity = 0.5;
+  }
+  return req;
+}
+
+qualpal::search_options strategy_options(std::size_t k) {
+  qualpal::search_options opts;
+  opts.strategy = strategies[k];
+  return opts;
+}
+
+std::vector<double> repel(std::size_t n, qualpal::thread_pool* pool) {
+  qualpal::hsl_box box;
+  qualpal::predefined_colorspace("rainbow", box);
+  qualpal::repulsion_options opts;
+  opts.iterations = 50;
+  qualpal::repulsion_diagnostics diag;
+  return qualpal::repulsion_palette(box, n, opts, diag, 0, pool);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t callers = 8;
+  std::size_t requests = 50;
+  unsigned long seed = 1;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--callers")
+      callers = std::strtoul(argv[i + 1], 0, 10);
+    else if (arg == "--requests")
+      requests = std::strtoul(argv[i + 1], 0, 10);
+    else if (arg == "--seed")
+      seed = std::strtoul(argv[i + 1], 0, 10);
+    else {
+      std::fprintf(stderr, "usage: stress-engine [--callers C] [--requests R] [--seed S]\n");
+      return 2;
+    }
+  }
+
+  const std::size_t n_spaces = sizeof(spaces)/sizeof(spaces[0]);
+
+  // The shared state, and the results that callers must reproduce
+  qualpal::engine eng(4, 2);
+  qualpal::palette_request base;
+  base.n_points = 500;
+  qualpal::predefined_colorspace("rainbow", base.box);
+  const std::shared_ptr<const qualpal::candidate_set> cs =
+    qualpal::make_candidates(base, &eng.pool());
+
+  search_reference searches;
+  for (std::size_t k = 0; k < 3; ++k)
+    for (std::size_t n = 0; n <= n_max; ++n)
+      searches.indices[k].push_back(
+        n < 2 ? std::vector<std::size_t>() :
+        qualpal::select_palette(*cs, n, 0, strategy_options(k)).indices);
+
+  std::vector<std::vector<std::vector<std::string> > > palettes(n_spaces);
+  {
+    qualpal::engine serial(0, 0);
+    for (std::size_t space = 0; space < n_spaces; ++space)
+      for (std::size_t n = 0; n <= n_max; ++n)
+        palettes[space].push_back(
+          n < 2 ? std::vector<std::string>() :
+          serial.generate(engine_request(space, n)).hex);
+  }
+
+  std::vector<std::vector<double> > repelled;
+  for (std::size_t n = 0; n <= n_max; ++n)
+    repelled.push_back(n < 2 ? std::vector<double>() : repel(n, 0));
+
+  std::atomic<std::size_t> failures(0), done(0);
+  std::vector<std::thread> threads;
+
+  for (std::size_t c = 0; c < callers; ++c) {
+    threads.push_back(std::thread([&, c]() {
+      std::mt19937 rng(seed + c);
+      for (std::size_t r = 0; r < requests; ++r) {
+        const std::size_t n = 2 + rng() % (n_max - 1);
+        bool ok = false;
+
+        switch (rng() % 3) {
+        case 0: {
+          const std::size_t k = rng() % 3;
+          ok = qualpal::select_palette(*cs, n, 0, strategy_options(k)).indices ==
+            searches.indices[k][n];
+          break;
+        }
+        case 1: {
+          const std::size_t space = rng() % n_spaces;
+          ok = eng.generate(engine_request(space, n)).hex == palettes[space][n];
+          break;
+        }
+        default:
+          ok = repel(n, &eng.pool()) == repelled[n];
+        }
+
+        if (r % 10 == 0) {
+          const qualpal::stats_snapshot stats = qualpal::stats_collect();
+          ok = ok && stats.counters[qualpal::stats_calls_global] > 0;
+        }
+
+        if (!ok) {
+          failures++;
+          std::fprintf(stderr, "caller %lu, request %lu (n = %lu): mismatch\n",
+                       static_cast<unsigned long>(c),
+                       static_cast<unsigned long>(r),
+                       static_cast<unsigned long>(n));
+        }
+        done++;
+      }
+    }));
+  }
+
+  for (std::size_t c = 0; c < threads.size(); ++c)
+    threads[c].join();
+
+  std::printf("%lu palettes from %lu callers, %lu failures (seed %lu)\n",
+              static_cast<unsigned long>(done.load()),
+              static_cast<unsigned long>(callers),
+              static_cast<unsigned long>(failures.load()), seed);
+
+  return failures > 0;
+}
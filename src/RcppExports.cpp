@@ -18,21 +18,372 @@ BEGIN_RCPP
 END_RCPP
 }
 // farthest_points
-arma::uvec farthest_points(const Rcpp::NumericMatrix& data, const arma::uword n);
-RcppExport SEXP _qualpalr_farthest_points(SEXP dataSEXP, SEXP nSEXP) {
+Rcpp::IntegerVector farthest_points(const Rcpp::NumericMatrix& data, const arma::uword n, const std::string strategy, const bool reorder);
+RcppExport SEXP _qualpalr_farthest_points(SEXP dataSEXP, SEXP nSEXP, SEXP strategySEXP, SEXP reorderSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type data(dataSEXP);
     Rcpp::traits::input_parameter< const arma::uword >::type n(nSEXP);
-    rcpp_result_gen = Rcpp::wrap(farthest_points(data, n));
+    Rcpp::traits::input_parameter< const std::string >::type strategy(strategySEXP);
+    Rcpp::traits::input_parameter< const bool >::type reorder(reorderSEXP);
+    rcpp_result_gen = Rcpp::wrap(farthest_points(data, n, strategy, reorder));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// divide_points
+Rcpp::IntegerVector divide_points(const Rcpp::NumericMatrix& data, const arma::uword n, const int region_size);
+RcppExport SEXP _qualpalr_divide_points(SEXP dataSEXP, SEXP nSEXP, SEXP region_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const arma::uword >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const int >::type region_size(region_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(divide_points(data, n, region_size));
+    return rcpp_result_gen;
+END_RCPP
+}
+// max_n_points
+Rcpp::IntegerVector max_n_points(const Rcpp::NumericMatrix& data, const double target, const arma::uword n_max);
+RcppExport SEXP _qualpalr_max_n_points(SEXP dataSEXP, SEXP targetSEXP, SEXP n_maxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const double >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< const arma::uword >::type n_max(n_maxSEXP);
+    rcpp_result_gen = Rcpp::wrap(max_n_points(data, target, n_max));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tree_points
+Rcpp::IntegerVector tree_points(const Rcpp::NumericMatrix& data, const arma::uword n, const std::string metric);
+RcppExport SEXP _qualpalr_tree_points(SEXP dataSEXP, SEXP nSEXP, SEXP metricSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const arma::uword >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type metric(metricSEXP);
+    rcpp_result_gen = Rcpp::wrap(tree_points(data, n, metric));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repel_points
+Rcpp::NumericMatrix repel_points(const Rcpp::NumericVector& h, const Rcpp::NumericVector& s, const Rcpp::NumericVector& l, const arma::uword n, const bool snap);
+RcppExport SEXP _qualpalr_repel_points(SEXP hSEXP, SEXP sSEXP, SEXP lSEXP, SEXP nSEXP, SEXP snapSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type s(sSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type l(lSEXP);
+    Rcpp::traits::input_parameter< const arma::uword >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const bool >::type snap(snapSEXP);
+    rcpp_result_gen = Rcpp::wrap(repel_points(h, s, l, n, snap));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trace_start
+bool trace_start();
+RcppExport SEXP _qualpalr_trace_start() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(trace_start());
+    return rcpp_result_gen;
+END_RCPP
+}
+// trace_write
+bool trace_write(const std::string file);
+RcppExport SEXP _qualpalr_trace_write(SEXP fileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type file(fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(trace_write(file));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// perf_start
+bool perf_start();
+RcppExport SEXP _qualpalr_perf_start() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(perf_start());
+    return rcpp_result_gen;
+END_RCPP
+}
+// perf_phase_begin
+void perf_phase_begin(const std::string phase);
+RcppExport SEXP _qualpalr_perf_phase_begin(SEXP phaseSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type phase(phaseSEXP);
+    perf_phase_begin(phase);
+    return R_NilValue;
+END_RCPP
+}
+// perf_phase_end
+void perf_phase_end(const std::string phase);
+RcppExport SEXP _qualpalr_perf_phase_end(SEXP phaseSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type phase(phaseSEXP);
+    perf_phase_end(phase);
+    return R_NilValue;
+END_RCPP
+}
+// perf_stop
+Rcpp::DataFrame perf_stop();
+RcppExport SEXP _qualpalr_perf_stop() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(perf_stop());
+    return rcpp_result_gen;
+END_RCPP
+}
+// image_colors
+Rcpp::NumericMatrix image_colors(const std::string file, const std::string format, const int max_colors);
+RcppExport SEXP _qualpalr_image_colors(SEXP fileSEXP, SEXP formatSEXP, SEXP max_colorsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< const int >::type max_colors(max_colorsSEXP);
+    rcpp_result_gen = Rcpp::wrap(image_colors(file, format, max_colors));
+    return rcpp_result_gen;
+END_RCPP
+}
+// stats_get
+Rcpp::List stats_get();
+RcppExport SEXP _qualpalr_stats_get() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(stats_get());
+    return rcpp_result_gen;
+END_RCPP
+}
+// stats_clear
+void stats_clear();
+RcppExport SEXP _qualpalr_stats_clear() {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    stats_clear();
+    return R_NilValue;
+END_RCPP
+}
+// stats_count
+void stats_count(const std::string counter);
+RcppExport SEXP _qualpalr_stats_count(SEXP counterSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type counter(counterSEXP);
+    stats_count(counter);
+    return R_NilValue;
+END_RCPP
+}
+// stats_time
+void stats_time(const std::string phase, const double seconds);
+RcppExport SEXP _qualpalr_stats_time(SEXP phaseSEXP, SEXP secondsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type phase(phaseSEXP);
+    Rcpp::traits::input_parameter< const double >::type seconds(secondsSEXP);
+    stats_time(phase, seconds);
+    return R_NilValue;
+END_RCPP
+}
+// torus_points
+Rcpp::NumericMatrix torus_points(const int n);
+RcppExport SEXP _qualpalr_torus_points(SEXP nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const int >::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(torus_points(n));
+    return rcpp_result_gen;
+END_RCPP
+}
+// hash_raw
+std::string hash_raw(const Rcpp::RawVector& x);
+RcppExport SEXP _qualpalr_hash_raw(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RawVector& >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(hash_raw(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// native_warmup
+void native_warmup();
+RcppExport SEXP _qualpalr_native_warmup() {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    native_warmup();
+    return R_NilValue;
+END_RCPP
+}
+// async_start
+SEXP async_start(const Rcpp::NumericMatrix& data, const int n, const std::string engine, const std::string metric, const int region_size);
+RcppExport SEXP _qualpalr_async_start(SEXP dataSEXP, SEXP nSEXP, SEXP engineSEXP, SEXP metricSEXP, SEXP region_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type engine(engineSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type metric(metricSEXP);
+    Rcpp::traits::input_parameter< const int >::type region_size(region_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(async_start(data, n, engine, metric, region_size));
+    return rcpp_result_gen;
+END_RCPP
+}
+// async_ready
+bool async_ready(SEXP job);
+RcppExport SEXP _qualpalr_async_ready(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(async_ready(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// async_cancel
+void async_cancel(SEXP job);
+RcppExport SEXP _qualpalr_async_cancel(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    async_cancel(job);
+    return R_NilValue;
+END_RCPP
+}
+// async_result
+Rcpp::IntegerVector async_result(SEXP job);
+RcppExport SEXP _qualpalr_async_result(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(async_result(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// session_start
+SEXP session_start(const int n, const int n_points, const std::string& cvd, const double cvd_severity, const double frame_budget);
+RcppExport SEXP _qualpalr_session_start(SEXP nSEXP, SEXP n_pointsSEXP, SEXP cvdSEXP, SEXP cvd_severitySEXP, SEXP frame_budgetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_points(n_pointsSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type cvd(cvdSEXP);
+    Rcpp::traits::input_parameter< const double >::type cvd_severity(cvd_severitySEXP);
+    Rcpp::traits::input_parameter< const double >::type frame_budget(frame_budgetSEXP);
+    rcpp_result_gen = Rcpp::wrap(session_start(n, n_points, cvd, cvd_severity, frame_budget));
+    return rcpp_result_gen;
+END_RCPP
+}
+// session_update
+Rcpp::List session_update(SEXP session, const Rcpp::NumericVector& h, const Rcpp::NumericVector& s, const Rcpp::NumericVector& l);
+RcppExport SEXP _qualpalr_session_update(SEXP sessionSEXP, SEXP hSEXP, SEXP sSEXP, SEXP lSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type s(sSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type l(lSEXP);
+    rcpp_result_gen = Rcpp::wrap(session_update(session, h, s, l));
+    return rcpp_result_gen;
+END_RCPP
+}
+// session_refine
+Rcpp::List session_refine(SEXP session);
+RcppExport SEXP _qualpalr_session_refine(SEXP sessionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    rcpp_result_gen = Rcpp::wrap(session_refine(session));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cost_model_get
+Rcpp::List cost_model_get();
+RcppExport SEXP _qualpalr_cost_model_get() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(cost_model_get());
+    return rcpp_result_gen;
+END_RCPP
+}
+// cost_model_set
+Rcpp::List cost_model_set(const double ns_per_distance, const double ns_startup, const double ns_per_chunk);
+RcppExport SEXP _qualpalr_cost_model_set(SEXP ns_per_distanceSEXP, SEXP ns_startupSEXP, SEXP ns_per_chunkSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const double >::type ns_per_distance(ns_per_distanceSEXP);
+    Rcpp::traits::input_parameter< const double >::type ns_startup(ns_startupSEXP);
+    Rcpp::traits::input_parameter< const double >::type ns_per_chunk(ns_per_chunkSEXP);
+    rcpp_result_gen = Rcpp::wrap(cost_model_set(ns_per_distance, ns_startup, ns_per_chunk));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cost_model_calibrate
+Rcpp::List cost_model_calibrate();
+RcppExport SEXP _qualpalr_cost_model_calibrate() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(cost_model_calibrate());
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
     {"_qualpalr_edist", (DL_FUNC) &_qualpalr_edist, 1},
-    {"_qualpalr_farthest_points", (DL_FUNC) &_qualpalr_farthest_points, 2},
+    {"_qualpalr_farthest_points", (DL_FUNC) &_qualpalr_farthest_points, 4},
+    {"_qualpalr_divide_points", (DL_FUNC) &_qualpalr_divide_points, 3},
+    {"_qualpalr_max_n_points", (DL_FUNC) &_qualpalr_max_n_points, 3},
+    {"_qualpalr_tree_points", (DL_FUNC) &_qualpalr_tree_points, 3},
+    {"_qualpalr_repel_points", (DL_FUNC) &_qualpalr_repel_points, 5},
+    {"_qualpalr_trace_start", (DL_FUNC) &_qualpalr_trace_start, 0},
+    {"_qualpalr_trace_write", (DL_FUNC) &_qualpalr_trace_write, 1},
+    {"_qualpalr_perf_start", (DL_FUNC) &_qualpalr_perf_start, 0},
+    {"_qualpalr_perf_phase_begin", (DL_FUNC) &_qualpalr_perf_phase_begin, 1},
+    {"_qualpalr_perf_phase_end", (DL_FUNC) &_qualpalr_perf_phase_end, 1},
+    {"_qualpalr_perf_stop", (DL_FUNC) &_qualpalr_perf_stop, 0},
+    {"_qualpalr_image_colors", (DL_FUNC) &_qualpalr_image_colors, 3},
+    {"_qualpalr_stats_get", (DL_FUNC) &_qualpalr_stats_get, 0},
+    {"_qualpalr_stats_clear", (DL_FUNC) &_qualpalr_stats_clear, 0},
+    {"_qualpalr_stats_count", (DL_FUNC) &_qualpalr_stats_count, 1},
+    {"_qualpalr_stats_time", (DL_FUNC) &_qualpalr_stats_time, 2},
+    {"_qualpalr_torus_points", (DL_FUNC) &_qualpalr_torus_points, 1},
+    {"_qualpalr_hash_raw", (DL_FUNC) &_qualpalr_hash_raw, 1},
+    {"_qualpalr_native_warmup", (DL_FUNC) &_qualpalr_native_warmup, 0},
+    {"_qualpalr_async_start", (DL_FUNC) &_qualpalr_async_start, 5},
+    {"_qualpalr_async_ready", (DL_FUNC) &_qualpalr_async_ready, 1},
+    {"_qualpalr_async_cancel", (DL_FUNC) &_qualpalr_async_cancel, 1},
+    {"_qualpalr_async_result", (DL_FUNC) &_qualpalr_async_result, 1},
+    {"_qualpalr_session_start", (DL_FUNC) &_qualpalr_session_start, 5},
+    {"_qualpalr_session_update", (DL_FUNC) &_qualpalr_session_update, 4},
+    {"_qualpalr_session_refine", (DL_FUNC) &_qualpalr_session_refine, 1},
+    {"_qualpalr_cost_model_get", (DL_FUNC) &_qualpalr_cost_model_get, 0},
+    {"_qualpalr_cost_model_set", (DL_FUNC) &_qualpalr_cost_model_set, 3},
+    {"_qualpalr_cost_model_calibrate", (DL_FUNC) &_qualpalr_cost_model_calibrate, 0},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,223 @@
+// Per-request scratch memory for the native core.
+//
+// An arena hands out memory by bumping a pointer through large blocks and
+// frees nothing until it is reset, so a request that needs many short-lived
+// buffers (the bookkeeping of the swap search, for instance) costs a couple
+// of block allocations instead of one malloc() per buffer. Every thread has
+// its own arena (thread_arena()), so requests running concurrently on a
+// thread pool never contend for it.
+//
+// Code opts in by opening an arena_scope for the duration of a request and
+// using scratch_vector<T> for its buffers: inside a scope, scratch vectors
+// allocate from the thread's arena; outside of one, they fall back to the
+// global heap. Resetting keeps the memory, coalescing it into a single block
+// when it had to grow, so once a thread has served a request of a given size
+// further requests of that size do not allocate scratch memory at all.
+
+#ifndef QUALPALR_ARENA_H
+#define QUALPALR_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "stats.h"
+
+namespace qualpal {
+
+class arena {
+public:
+  explicit arena(std::size_t block_size = 1 << 16)
+    : block_size(block_size), used(0), n_allocations(0), n_blocks(0) {}
+
+  ~arena() { release(); }
+
+  void* allocate(std::size_t bytes, std::size_t align) {
+    n_allocations++;
+
+    if (!blocks.empty()) {
+      std::size_t offset = (used + align - 1) & ~(align - 1);
+      if (offset + bytes <= blocks.back().size) {
+        used = offset + bytes;
+        return blocks.back().data + offset;
+      }
+    }
+
+    grow(bytes + align);
+    std::size_t offset = (used + align - 1) & ~(align - 1);
+    used = offset + bytes;
+    return blocks.back().data + offset;
+  }
+
+  // Make sure that the next `bytes` bytes fit into the current block
+  void reserve(std::size_t bytes) {
+    if (blocks.empty() || blocks.back().size - used < bytes)
+      grow(bytes);
+  }
+
+  // Forget all allocations, keeping the memory for the next request
+  void reset() {
+    if (blocks.size() > 1) {
+      std::size_t total = 0;
+      for (std::size_t i = 0; i < blocks.size(); ++i)
+        total += blocks[i].size;
+      release();
+      add_block(total);
+    }
+    used = 0;
+    n_allocations = 0;
+  }
+
+  // Allocations served since the last reset
+  std::size_t allocations() const { return n_allocations; }
+
+  // Blocks obtained from the global heap over the arena's lifetime
+  std::size_t block_allocations() const { return n_blocks; }
+
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+      total += blocks[i].size;
+    return total;
+  }
+
+private:
+  struct block {
+    char* data;
+    std::size_t size;
+  };
+
+  arena(const arena&);
+  arena& operator=(const arena&);
+
+  void grow(std::size_t bytes) {
+    std::size_t size = block_size;
+    if (!blocks.empty())
+      size = 2*blocks.back().size;
+    while (size < bytes)
+      size *= 2;
+    add_block(size);
+  }
+
+  void add_block(std::size_t size) {
+    block b = {static_cast<char*>(::operator new(size)), size};
+    stats_add(stats_bytes_allocated, size);
+    blocks.push_back(b);
+    used = 0;
+    n_blocks++;
+  }
+
+  void release() {
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+      ::operator delete(blocks[i].data);
+    blocks.clear();
+    used = 0;
+  }
+
+  std::size_t block_size;
+  std::size_t used;  // bytes used in the last block
+  std::size_t n_allocations, n_blocks;
+  std::vector<block> blocks;
+};
+
+inline arena& thread_arena() {
+  static thread_local arena a;
+  return a;
+}
+
+// The arena that scratch vectors on this thread allocate from, if any
+inline arena*& current_arena() {
+  static thread_local arena* a = 0;
+  return a;
+}
+
+// Routes scratch allocations on this thread to `a` for the lifetime of the
+// scope. The outermost scope resets the arena and reserves `bytes` up front;
+// nested scopes share the allocations of the enclosing one.
+class arena_scope {
+public:
+  explicit arena_scope(arena& a = thread_arena(), std::size_t bytes = 0)
+    : previous(current_arena()) {
+    if (previous != &a) {
+      a.reset();
+      current_arena() = &a;
+    }
+    a.reserve(bytes);
+  }
+
+  ~arena_scope() { current_arena() = previous; }
+
+private:
+  arena_scope(const arena_scope&);
+  arena_scope& operator=(const arena_scope&);
+
+  arena* previous;
+};
+
+// An allocator that uses the arena that was current when it was created,
+// or the global heap if there was none
+template <typename T>
+class arena_allocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  template <typename U>
+  struct rebind {
+    typedef arena_allocator<U> other;
+  };
+
+  arena_allocator() : source(current_arena()) {}
+
+  template <typename U>
+  arena_allocator(const arena_allocator<U>& other) : source(other.source) {}
+
+  T* allocate(std::size_t n) {
+    if (source)
+      return static_cast<T*>(source->allocate(n*sizeof(T), alignof(T)));
+    return static_cast<T*>(::operator new(n*sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t) {
+    if (!source)
+      ::operator delete(p);
+  }
+
+  std::size_t max_size() const { return std::size_t(-1)/sizeof(T); }
+
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  arena* source;
+};
+
+template <typename T, typename U>
+inline bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+  return a.source == b.source;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+  return a.source != b.source;
+}
+
+template <typename T>
+using scratch_vector = std::vector<T, arena_allocator<T> >;
+
+} // namespace qualpal
+
+#endif // QUALPALR_ARENA_H
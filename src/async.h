@@ -0,0 +1,206 @@
+// Palette searches on a background thread, so that callers with an event
+// loop (Shiny, plumber) can poll for the result instead of blocking.
+//
+// The job owns copies of its inputs and uses nothing but the standard
+// library, so it never touches R from the background thread. It runs the
+// engine that select_colors() in R/qualpal.R picks for the same candidates,
+// on the background thread alone: the global or local search on a distance
+// matrix that is computed serially, with checks for cancellation between
+// blocks of rows, divide and conquer, or the metric tree. All of them check
+// for cancellation between slots of the swap search.
+
+#ifndef QUALPALR_ASYNC_H
+#define QUALPALR_ASYNC_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "distance.h"
+#include "divide_conquer.h"
+#include "farthest_points.h"
+#include "knn_graph.h"
+#include "locality.h"
+#include "metric_tree.h"
+#include "stats.h"
+
+namespace qualpal {
+
+// The engines of select_colors()
+enum async_engine {
+  async_global,
+  async_local,
+  async_divide,
+  async_tree
+};
+
+inline bool parse_async_engine(const std::string& name, async_engine& out) {
+  if (name == "global")
+    out = async_global;
+  else if (name == "local")
+    out = async_local;
+  else if (name == "divide")
+    out = async_divide;
+  else if (name == "tree")
+    out = async_tree;
+  else
+    return false;
+  return true;
+}
+
+// How an asynchronous job selects its colors
+struct async_plan {
+  async_engine engine;
+  bool ciede2000;           // the tree under CIEDE2000 instead of DIN99d
+  std::size_t region_size;  // for divide and conquer
+
+  async_plan() : engine(async_global), ciede2000(false), region_size(1024) {}
+};
+
+class async_search {
+public:
+  // `din99d` holds N colors, row-major
+  async_search(const std::vector<double>& din99d,
+               std::size_t n,
+               const async_plan& plan,
+               const search_options& opts)
+    : x(din99d), n(n), plan(plan), opts(opts), n_regions(0), done(false),
+      cancelled(false) {
+    this->opts.cancel = &cancelled;
+    worker = std::thread(&async_search::run, this);
+  }
+
+  ~async_search() {
+    cancel();
+    wait();
+  }
+
+  bool ready() const { return done.load(std::memory_order_acquire); }
+
+  void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+  // Wait for the search to finish and return the selected indices, ordered
+  // by distinctness. Throws if the search failed or if cancel() has been
+  // called, also when the search finished before it noticed.
+  const std::vector<std::size_t>& result() {
+    wait();
+    if (!error.empty())
+      throw std::runtime_error(error);
+    if (diag.cancelled || cancelled.load(std::memory_order_relaxed))
+      throw std::runtime_error("the palette search was cancelled");
+    return indices;
+  }
+
+  const async_plan& engine_plan() const { return plan; }
+  const search_diagnostics& diagnostics() const { return diag; }
+  std::size_t regions() const { return n_regions; }
+
+private:
+  async_search(const async_search&);
+  async_search& operator=(const async_search&);
+
+  void wait() {
+    if (worker.joinable())
+      worker.join();
+  }
+
+  void run() {
+    try {
+      stats_add(stats_calls_async);
+
+      const std::size_t N = x.size()/3;
+      diag.cancelled = cancelled.load(std::memory_order_relaxed);
+      if (diag.cancelled) {
+        // Nothing to do
+      } else if (plan.engine == async_divide) {
+        divide_options dopts;
+        dopts.region_size = plan.region_size;
+        indices = divide_farthest_points(x.data(), N, n, opts, dopts, diag,
+                                         n_regions);
+      } else if (plan.engine == async_tree && plan.ciede2000) {
+        const ciede2000_metric d(x);
+        indices = tree_farthest_points(d, N, n, opts, diag);
+      } else if (plan.engine == async_tree) {
+        const coordinate_metric d = {x.data(), metric_din99d};
+        indices = tree_farthest_points(d, N, n, opts, diag);
+      } else {
+        matrix_search(N);
+      }
+      if (plan.engine != async_divide)
+        stats_add_outcome(diag);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+
+    done.store(true, std::memory_order_release);
+  }
+
+  // The global or local search on the full distance matrix, over the
+  // candidates in Morton order like farthest_points() in qualpal.cpp, so
+  // that ties are broken the same way
+  void matrix_search(std::size_t N) {
+    const candidate_order order = morton_order(x);
+    std::vector<double> y(x.size());
+    for (std::size_t i = 0; i < N; ++i)
+      for (int k = 0; k < 3; ++k)
+        y[3*i + k] = x[3*order.order[i] + k];
+
+    std::vector<double> dm(N*N);
+    stats_add(stats_bytes_allocated, dm.size()*sizeof(double));
+
+    {
+      stats_timer timer(stats_distances);
+      for (std::size_t begin = 0; begin < N && !diag.cancelled; begin += 64) {
+        distance_rows(y.data(), N, metric_din99d, dm.data(), begin,
+                      std::min(begin + 64, N));
+        diag.cancelled = cancelled.load(std::memory_order_relaxed);
+      }
+    }
+    if (diag.cancelled)
+      return;
+
+    search_options search = opts;
+    knn_graph graph;
+    if (plan.engine == async_local) {
+      search.strategy = swap_local;
+      graph = make_knn_graph(y.data(), N, search.n_neighbors);
+      search.neighbors = graph.neighbors.data();
+      search.n_neighbors = graph.k;
+    }
+
+    search.tie_rank = order.order.data();
+    std::vector<std::size_t> r = initial_selection(N, n);
+    for (std::size_t i = 0; i < n; ++i)
+      r[i] = order.rank[r[i]];
+
+    arena_scope scratch(thread_arena(), search_scratch_bytes(N, n, search));
+    swap_search(dm.data(), N, r, search, diag);
+    r = order_selection(dm.data(), N, r);
+
+    indices.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+      indices[i] = order.order[r[i]];
+  }
+
+  std::vector<double> x;
+  std::size_t n;
+  const async_plan plan;
+  search_options opts;
+  std::size_t n_regions;
+
+  std::atomic<bool> done, cancelled;
+  std::thread worker;
+
+  std::vector<std::size_t> indices;
+  search_diagnostics diag;
+  std::string error;
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_ASYNC_H
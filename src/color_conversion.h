@@ -0,0 +1,439 @@
+// Color conversions used by the native engine.
+//
+// These mirror the R implementations in R/color-conversion.R and
+// R/cvd-simulation.R one color at a time, so that native code can go from
+// an HSL color space to DIN99d coordinates without R. Colors are stored
+// row-major, three doubles per color.
+
+#ifndef QUALPALR_COLOR_CONVERSION_H
+#define QUALPALR_COLOR_CONVERSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace qualpal {
+
+// sRGB (D65) to XYZ
+inline void rgb_xyz(const double* rgb, double* xyz) {
+  double lin[3];
+  for (int k = 0; k < 3; ++k)
+    lin[k] = rgb[k] > 0.04045 ? std::pow((rgb[k] + 0.055)/1.055, 2.4)
+                              : rgb[k]/12.92;
+
+  xyz[0] = 0.4124564*lin[0] + 0.3575761*lin[1] + 0.1804375*lin[2];
+  xyz[1] = 0.2126729*lin[0] + 0.7151522*lin[1] + 0.0721750*lin[2];
+  xyz[2] = 0.0193339*lin[0] + 0.1191920*lin[1] + 0.9503041*lin[2];
+}
+
+inline void xyz_lab(const double* xyz,
+                    double* lab,
+                    double Xr = 0.95047,
+                    double Yr = 1,
+                    double Zr = 1.08883) {
+  const double epsilon = 216.0/24389.0;
+  const double kelvin = 24389.0/27.0;
+  const double r[3] = {xyz[0]/Xr, xyz[1]/Yr, xyz[2]/Zr};
+  double f[3];
+
+  for (int k = 0; k < 3; ++k)
+    f[k] = r[k] > epsilon ? std::pow(r[k], 1.0/3.0) : (r[k]*kelvin + 16)/116;
+
+  lab[0] = 116*f[1] - 16;
+  lab[1] = 500*(f[0] - f[1]);
+  lab[2] = 200*(f[1] - f[2]);
+}
+
+inline void xyz_din99d(const double* xyz, double* din99d) {
+  const double adjusted[3] = {1.12*xyz[0] - 0.12*xyz[2], xyz[1], xyz[2]};
+  double lab[3];
+  xyz_lab(adjusted, lab);
+
+  const double pi = 3.14159265358979323846;
+  const double u = 50*pi/180;
+  const double e = lab[1]*std::cos(u) + lab[2]*std::sin(u);
+  const double f = 1.14*(lab[2]*std::cos(u) - lab[1]*std::sin(u));
+  const double G = std::sqrt(e*e + f*f);
+  const double C99d = 22.5*std::log(1 + 0.06*G);
+  const double h99d = std::atan2(f, e) + u;
+
+  din99d[0] = 325.22*std::log(1 + 0.0036*lab[0]);
+  din99d[1] = C99d*std::cos(h99d);
+  din99d[2] = C99d*std::sin(h99d);
+}
+
+// XYZ to sRGB (D65), as in XYZ_sRGB(); out-of-gamut colors are not clipped
+inline void xyz_rgb(const double* xyz, double* rgb) {
+  const double lin[3] = {
+     3.2404548360*xyz[0] - 1.5371388501*xyz[1] - 0.4985315469*xyz[2],
+    -0.9692663899*xyz[0] + 1.8760109288*xyz[1] + 0.0415560823*xyz[2],
+     0.0556434196*xyz[0] - 0.2040258543*xyz[1] + 1.0572251625*xyz[2]
+  };
+
+  for (int k = 0; k < 3; ++k)
+    rgb[k] = lin[k] > 0.0031308 ? 1.055*std::pow(lin[k], 1/2.4) - 0.055
+                                : 12.92*lin[k];
+}
+
+inline void lab_xyz(const double* lab,
+                    double* xyz,
+                    double Xr = 0.95047,
+                    double Yr = 1,
+                    double Zr = 1.08883) {
+  const double epsilon = 216.0/24389.0;
+  const double kelvin = 24389.0/27.0;
+  const double fy = (lab[0] + 16)/116;
+  const double fx = lab[1]/500 + fy;
+  const double fz = fy - lab[2]/200;
+
+  const double xr = fx*fx*fx > epsilon ? fx*fx*fx : (116*fx - 16)/kelvin;
+  const double yr = lab[0] > kelvin*epsilon ? fy*fy*fy : lab[0]/kelvin;
+  const double zr = fz*fz*fz > epsilon ? fz*fz*fz : (116*fz - 16)/kelvin;
+
+  xyz[0] = Xr*xr;
+  xyz[1] = Yr*yr;
+  xyz[2] = Zr*zr;
+}
+
+// The inverse of xyz_din99d()
+inline void din99d_xyz(const double* din99d, double* xyz) {
+  const double pi = 3.14159265358979323846;
+  const double u = 50*pi/180;
+  const double C99d = std::sqrt(din99d[1]*din99d[1] + din99d[2]*din99d[2]);
+  const double G = (std::exp(C99d/22.5) - 1)/0.06;
+  const double h = std::atan2(din99d[2], din99d[1]) - u;
+  const double e = G*std::cos(h);
+  const double f = G*std::sin(h)/1.14;
+
+  const double lab[3] = {
+    (std::exp(din99d[0]/325.22) - 1)/0.0036,
+    e*std::cos(u) - f*std::sin(u),
+    e*std::sin(u) + f*std::cos(u)
+  };
+
+  double adjusted[3];
+  lab_xyz(lab, adjusted);
+
+  xyz[0] = (adjusted[0] + 0.12*adjusted[2])/1.12;
+  xyz[1] = adjusted[1];
+  xyz[2] = adjusted[2];
+}
+
+inline void hsl_rgb(const double* hsl, double* rgb) {
+  double H = hsl[0] < 0 ? hsl[0] + 360 : hsl[0];
+  const double S = hsl[1], L = hsl[2];
+
+  const double C = (1 - std::fabs(2*L - 1))*S;
+  const double Hp = H/60;
+  double Hmod2 = std::fmod(Hp, 2.0);
+  if (Hmod2 < 0)
+    Hmod2 += 2;
+  const double X = C*(1 - std::fabs(Hmod2 - 1));
+  const double m = L - C/2;
+
+  double R = 0, G = 0, B = 0;
+
+  if (Hp >= 0 && Hp < 1) {
+    R = C; G = X;
+  } else if (Hp >= 1 && Hp < 2) {
+    R = X; G = C;
+  } else if (Hp >= 2 && Hp < 3) {
+    G = C; B = X;
+  } else if (Hp >= 3 && Hp < 4) {
+    G = X; B = C;
+  } else if (Hp >= 4 && Hp < 5) {
+    R = X; B = C;
+  } else if (Hp >= 5 && Hp < 6) {
+    R = C; B = X;
+  }
+
+  rgb[0] = R + m;
+  rgb[1] = G + m;
+  rgb[2] = B + m;
+}
+
+inline void rgb_hsl(const double* rgb, double* hsl) {
+  const double R = rgb[0], G = rgb[1], B = rgb[2];
+  const double M = std::max(R, std::max(G, B));
+  const double m = std::min(R, std::min(G, B));
+  const double C = M - m;
+
+  double Hp = 0;
+  if (C > 0) {
+    if (M == R) {
+      Hp = std::fmod((G - B)/C, 6.0);
+      if (Hp < 0)
+        Hp += 6;
+    } else if (M == G) {
+      Hp = (B - R)/C + 2;
+    } else {
+      Hp = (R - G)/C + 4;
+    }
+  }
+
+  const double L = (M + m)/2;
+
+  hsl[0] = Hp*60;
+  hsl[1] = C > 0 ? C/(1 - std::fabs(2*L - 1)) : 0;
+  hsl[2] = L;
+}
+
+enum cvd_type { cvd_protan, cvd_deutan, cvd_tritan };
+
+// Parse "protan", "deutan", or "tritan"; returns false otherwise
+inline bool parse_cvd(const std::string& name, cvd_type& type) {
+  if (name == "protan")
+    type = cvd_protan;
+  else if (name == "deutan")
+    type = cvd_deutan;
+  else if (name == "tritan")
+    type = cvd_tritan;
+  else
+    return false;
+  return true;
+}
+
+// Color vision deficiency simulation matrices from Machado 2010 for
+// severities 0, 0.1, ..., 1 (see data-raw/gen-cvd-mats.R)
+inline const double (*cvd_matrix(cvd_type type, int severity))[3] {
+  static const double cvd_matrices[3][11][3][3] = {
+    // Protanomaly
+    {
+      {{ 1.000,  0.000,  0.000},
+       { 0.000,  1.000,  0.000},
+       { 0.000,  0.000,  1.000}},
+      {{ 0.856,  0.182, -0.038},
+       { 0.029,  0.955,  0.016},
+       {-0.003, -0.002,  1.004}},
+      {{ 0.735,  0.335, -0.070},
+       { 0.052,  0.919,  0.029},
+       {-0.005, -0.004,  1.009}},
+      {{ 0.630,  0.466, -0.096},
+       { 0.069,  0.890,  0.041},
+       {-0.006, -0.008,  1.014}},
+      {{ 0.539,  0.579, -0.118},
+       { 0.083,  0.866,  0.051},
+       {-0.007, -0.012,  1.019}},
+      {{ 0.458,  0.680, -0.138},
+       { 0.093,  0.846,  0.061},
+       {-0.007, -0.017,  1.024}},
+      {{ 0.385,  0.769, -0.154},
+       { 0.101,  0.830,  0.070},
+       {-0.007, -0.022,  1.030}},
+      {{ 0.320,  0.850, -0.169},
+       { 0.106,  0.816,  0.078},
+       {-0.007, -0.028,  1.035}},
+      {{ 0.259,  0.923, -0.182},
+       { 0.110,  0.804,  0.085},
+       {-0.006, -0.034,  1.041}},
+      {{ 0.204,  0.990, -0.194},
+       { 0.113,  0.795,  0.092},
+       {-0.005, -0.041,  1.046}},
+      {{ 0.152,  1.053, -0.205},
+       { 0.115,  0.786,  0.099},
+       {-0.004, -0.048,  1.052}}
+    },
+    // Deuteranomaly
+    {
+      {{ 1.000,  0.000,  0.000},
+       { 0.000,  1.000,  0.000},
+       { 0.000,  0.000,  1.000}},
+      {{ 0.866,  0.178, -0.044},
+       { 0.050,  0.939,  0.011},
+       {-0.003,  0.007,  0.996}},
+      {{ 0.761,  0.319, -0.080},
+       { 0.091,  0.889,  0.020},
+       {-0.006,  0.013,  0.993}},
+      {{ 0.675,  0.434, -0.109},
+       { 0.125,  0.848,  0.027},
+       {-0.008,  0.019,  0.989}},
+      {{ 0.606,  0.529, -0.134},
+       { 0.155,  0.812,  0.032},
+       {-0.009,  0.023,  0.986}},
+      {{ 0.547,  0.608, -0.155},
+       { 0.182,  0.782,  0.037},
+       {-0.010,  0.027,  0.983}},
+      {{ 0.499,  0.675, -0.174},
+       { 0.205,  0.755,  0.040},
+       {-0.011,  0.031,  0.980}},
+      {{ 0.458,  0.732, -0.190},
+       { 0.226,  0.731,  0.043},
+       {-0.012,  0.034,  0.977}},
+      {{ 0.423,  0.781, -0.204},
+       { 0.246,  0.710,  0.045},
+       {-0.012,  0.037,  0.974}},
+      {{ 0.393,  0.824, -0.217},
+       { 0.264,  0.690,  0.046},
+       {-0.012,  0.040,  0.972}},
+      {{ 0.367,  0.861, -0.228},
+       { 0.280,  0.673,  0.047},
+       {-0.012,  0.043,  0.969}}
+    },
+    // Tritanomaly
+    {
+      {{ 1.000,  0.000,  0.000},
+       { 0.000,  1.000,  0.000},
+       { 0.000,  0.000,  1.000}},
+      {{ 0.927,  0.093, -0.019},
+       { 0.021,  0.965,  0.014},
+       { 0.008,  0.055,  0.937}},
+      {{ 0.896,  0.133, -0.029},
+       { 0.030,  0.945,  0.025},
+       { 0.013,  0.105,  0.882}},
+      {{ 0.906,  0.128, -0.034},
+       { 0.027,  0.941,  0.032},
+       { 0.013,  0.148,  0.838}},
+      {{ 0.948,  0.089, -0.038},
+       { 0.014,  0.947,  0.039},
+       { 0.011,  0.194,  0.795}},
+      {{ 1.017,  0.027, -0.044},
+       {-0.006,  0.958,  0.048},
+       { 0.006,  0.249,  0.745}},
+      {{ 1.105, -0.047, -0.058},
+       {-0.032,  0.972,  0.061},
+       { 0.001,  0.318,  0.681}},
+      {{ 1.193, -0.110, -0.083},
+       {-0.058,  0.979,  0.079},
+       {-0.002,  0.403,  0.599}},
+      {{ 1.258, -0.140, -0.118},
+       {-0.078,  0.975,  0.103},
+       {-0.003,  0.501,  0.502}},
+      {{ 1.279, -0.125, -0.154},
+       {-0.085,  0.958,  0.127},
+       {-0.001,  0.601,  0.400}},
+      {{ 1.256, -0.077, -0.179},
+       {-0.078,  0.931,  0.148},
+       { 0.005,  0.691,  0.304}}
+    }
+  };
+
+  return cvd_matrices[type][severity];
+}
+
+// The simulation matrix for a severity in [0, 1], interpolated between the
+// tabulated matrices in the same way as sRGB_CVD()
+inline void cvd_simulation_matrix(cvd_type type,
+                                  double severity,
+                                  double (*out)[3]) {
+  severity *= 10;
+  const int fl = static_cast<int>(std::floor(severity));
+  const int ce = static_cast<int>(std::ceil(severity));
+  const double (*m1)[3] = cvd_matrix(type, fl);
+  const double (*m2)[3] = cvd_matrix(type, ce);
+
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      out[i][j] = m1[i][j] + (ce - severity)*(m2[i][j] - m1[i][j]);
+}
+
+inline void simulate_cvd(const double (*mat)[3], const double* rgb, double* out) {
+  for (int i = 0; i < 3; ++i)
+    out[i] = mat[i][0]*rgb[0] + mat[i][1]*rgb[1] + mat[i][2]*rgb[2];
+}
+
+// Point k (from 0) of the three-dimensional torus (Kronecker) sequence,
+// frac((k + 1)*sqrt(p)) for primes p = 2, 3, 5
+inline void torus_point(std::size_t k, double* out) {
+  const double roots[3] = {std::sqrt(2.0), std::sqrt(3.0), std::sqrt(5.0)};
+  for (int d = 0; d < 3; ++d) {
+    double x = double(k + 1)*roots[d];
+    out[d] = x - std::floor(x);
+  }
+}
+
+// The first n points of the torus sequence, as given by
+// randtoolbox::torus(n, dim = 3)
+inline std::vector<double> torus(std::size_t n) {
+  std::vector<double> out(3*n);
+  for (std::size_t k = 0; k < n; ++k)
+    torus_point(k, &out[3*k]);
+  return out;
+}
+
+// A subspace of the HSL color space
+struct hsl_box {
+  double h[2], s[2], l[2];
+};
+
+// The predefined color spaces of qualpal(); returns false for unknown names
+inline bool predefined_colorspace(const std::string& name, hsl_box& box) {
+  static const struct {
+    const char* name;
+    hsl_box box;
+  } spaces[] = {
+    {"pretty",      {{0, 360}, {0.2, 0.5}, {0.6, 0.85}}},
+    {"pretty_dark", {{0, 360}, {0.1, 0.5}, {0.2, 0.4}}},
+    {"rainbow",     {{0, 360}, {0,   1},   {0,   1}}},
+    {"pastels",     {{0, 360}, {0.2, 0.4}, {0.8, 0.9}}}
+  };
+
+  for (std::size_t i = 0; i < sizeof(spaces)/sizeof(spaces[0]); ++i) {
+    if (name == spaces[i].name) {
+      box = spaces[i].box;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Sample n colors (as HSL) from an HSL box, as in qualpal.list()
+inline std::vector<double> sample_hsl(const hsl_box& box, std::size_t n) {
+  std::vector<double> hsl = torus(n);
+
+  for (std::size_t k = 0; k < n; ++k) {
+    double* c = &hsl[3*k];
+    c[0] = (box.h[1] - box.h[0])*(c[0] - 1) + box.h[1];
+    c[1] = (box.s[1] - box.s[0])*(std::sqrt(c[1]) - 1) + box.s[1];
+    c[2] = (box.l[1] - box.l[0])*(c[2] - 1) + box.l[1];
+    if (c[0] < 0)
+      c[0] += 360;
+  }
+
+  return hsl;
+}
+
+// Format an sRGB color as in grDevices::rgb()
+inline std::string rgb_hex(const double* rgb) {
+  static const char digits[] = "0123456789ABCDEF";
+  std::string hex("#");
+  for (int k = 0; k < 3; ++k) {
+    double v = std::min(1.0, std::max(0.0, rgb[k]));
+    unsigned int x = static_cast<unsigned int>(255*v + 0.5);
+    hex += digits[x/16];
+    hex += digits[x % 16];
+  }
+  return hex;
+}
+
+// Parse "#RRGGBB" (or "RRGGBB"); returns false if malformed
+inline bool hex_rgb(const std::string& hex, double* rgb) {
+  std::size_t start = !hex.empty() && hex[0] == '#' ? 1 : 0;
+  if (hex.size() != start + 6)
+    return false;
+
+  for (int k = 0; k < 3; ++k) {
+    unsigned int x = 0;
+    for (int d = 0; d < 2; ++d) {
+      char ch = hex[start + 2*k + d];
+      x *= 16;
+      if (ch >= '0' && ch <= '9')
+        x += ch - '0';
+      else if (ch >= 'a' && ch <= 'f')
+        x += ch - 'a' + 10;
+      else if (ch >= 'A' && ch <= 'F')
+        x += ch - 'A' + 10;
+      else
+        return false;
+    }
+    rgb[k] = x/255.0;
+  }
+
+  return true;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_COLOR_CONVERSION_H
@@ -0,0 +1,108 @@
+// A streaming grid coreset: reduces an arbitrarily long stream of colors to
+// at most `capacity` representatives while keeping memory bounded.
+//
+// Colors are binned on a regular grid in DIN99d space and the first color
+// to arrive in each cell represents it. Until the capacity is reached every
+// distinct color is kept. When it would be exceeded, the cell width doubles
+// and the current representatives are rebinned. A color may thus be passed
+// on through several rebinnings, each moving it by at most a cell diagonal
+// at that width, so its representative ends up within twice the final cell
+// diagonal of it. Since the farthest points search only cares about how
+// spread out the colors are, this loses little for palette selection.
+
+#ifndef QUALPALR_CORESET_H
+#define QUALPALR_CORESET_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "color_conversion.h"
+#include "hash.h"
+
+namespace qualpal {
+
+class grid_coreset {
+public:
+  explicit grid_coreset(std::size_t capacity = 4000, double width = 0.5)
+    : capacity(capacity), initial_width(width), width(0), seen(0) {}
+
+  // Add one sRGB color (components in [0, 1])
+  void add(const double* rgb) {
+    double xyz[3], lab[3];
+    rgb_xyz(rgb, xyz);
+    xyz_din99d(xyz, lab);
+    seen++;
+
+    if (!insert(rgb, lab))
+      return;
+
+    while (rgb_.size()/3 > capacity)
+      coarsen();
+  }
+
+  std::size_t size() const { return rgb_.size()/3; }
+
+  // The number of colors added so far
+  std::size_t count() const { return seen; }
+
+  // The current cell width (0 while colors are only deduplicated)
+  double cell_width() const { return width; }
+
+  // Representatives, as row-major sRGB
+  const std::vector<double>& rgb() const { return rgb_; }
+
+private:
+  // A fixed-size key, so that binning a color allocates nothing
+  typedef std::array<long, 3> cell;
+
+  struct cell_hash {
+    std::size_t operator()(const cell& c) const {
+      return static_cast<std::size_t>(fnv1a(c.data(), sizeof(c)));
+    }
+  };
+
+  cell key(const double* lab) const {
+    cell out;
+    for (int k = 0; k < 3; ++k) {
+      // With no grid yet, distinct colors are only merged if they are equal
+      // after rounding to well below what can be told apart
+      const double w = width > 0 ? width : 1e-6;
+      out[k] = static_cast<long>(std::floor(lab[k]/w));
+    }
+    return out;
+  }
+
+  bool insert(const double* rgb, const double* lab) {
+    if (!cells.insert(std::make_pair(key(lab), size())).second)
+      return false;
+    rgb_.insert(rgb_.end(), rgb, rgb + 3);
+    lab_.insert(lab_.end(), lab, lab + 3);
+    return true;
+  }
+
+  void coarsen() {
+    width = width > 0 ? 2*width : initial_width;
+
+    std::vector<double> rgb, lab;
+    rgb.swap(rgb_);
+    lab.swap(lab_);
+    cells.clear();
+
+    for (std::size_t i = 0; i < rgb.size()/3; ++i)
+      insert(&rgb[3*i], &lab[3*i]);
+  }
+
+  std::size_t capacity;
+  double initial_width, width;
+  std::size_t seen;
+  std::vector<double> rgb_, lab_;
+  std::unordered_map<cell, std::size_t, cell_hash> cells;
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_CORESET_H
@@ -0,0 +1,150 @@
+// A cost model for deciding whether a phase is worth running in parallel,
+// and with what grain size.
+//
+// Spreading work over threads pays off only when the time saved exceeds what
+// it costs to wake the workers and hand out chunks. For the default 1000
+// candidate colors the distance matrix takes a few milliseconds, and the
+// distances among the handful of selected colors take microseconds, so the
+// fixed costs of threading matter. The model estimates
+//
+//   serial:   work
+//   parallel: startup + work/threads + chunks*per_chunk
+//
+// from the number of elementary operations in a phase and picks the faster
+// option. Grain sizes are chosen so that each thread gets a few chunks,
+// which balances the triangular workload of distance matrices.
+//
+// The defaults were measured on a typical x86-64 machine; calibrate()
+// measures them on the current one (see bench/bench-qualpal.R).
+
+#ifndef QUALPALR_COST_MODEL_H
+#define QUALPALR_COST_MODEL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "distance.h"
+
+namespace qualpal {
+
+struct parallel_plan {
+  std::size_t threads;  // 1 means serial
+  std::size_t grain;    // rows per chunk
+
+  bool parallel() const { return threads > 1; }
+};
+
+struct cost_model {
+  double ns_per_distance;  // one color difference
+  double ns_startup;       // waking the workers for a parallel loop
+  double ns_per_chunk;     // handing out one chunk
+  std::size_t chunks_per_thread;
+
+  cost_model()
+    : ns_per_distance(25),
+      ns_startup(40000),
+      ns_per_chunk(500),
+      chunks_per_thread(4) {}
+
+  // Rows [0, N) of a distance matrix, row i costing i distances
+  parallel_plan plan_distances(std::size_t N, std::size_t threads) const {
+    parallel_plan plan = {1, std::max<std::size_t>(N, 1)};
+    if (threads < 2 || N < 2)
+      return plan;
+
+    const double work = ns_per_distance*0.5*double(N)*double(N - 1);
+    const std::size_t chunks = std::min(N, chunks_per_thread*threads);
+    const double parallel = ns_startup + work/threads + chunks*ns_per_chunk;
+
+    if (parallel < work) {
+      plan.threads = threads;
+      plan.grain = std::max<std::size_t>(1, N/chunks);
+    }
+    return plan;
+  }
+};
+
+// The model used by the package, shared by all threads
+inline cost_model& global_cost_model() {
+  static cost_model model;
+  return model;
+}
+
+inline std::mutex& global_cost_model_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline cost_model current_cost_model() {
+  std::lock_guard<std::mutex> lock(global_cost_model_mutex());
+  return global_cost_model();
+}
+
+inline void set_cost_model(const cost_model& model) {
+  std::lock_guard<std::mutex> lock(global_cost_model_mutex());
+  global_cost_model() = model;
+}
+
+// The number of threads that parallel loops may use: RCPP_PARALLEL_NUM_THREADS
+// (which RcppParallel::setThreadOptions() sets) or the number of cores
+inline std::size_t available_threads() {
+  const char* env = std::getenv("RCPP_PARALLEL_NUM_THREADS");
+  if (env) {
+    long n = std::strtol(env, 0, 10);
+    if (n > 0)
+      return static_cast<std::size_t>(n);
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Measure the cost of a color difference on this machine. The costs of
+// threading depend on the threading library and are measured by the caller:
+// `run_parallel(k)` must run a parallel loop over k empty chunks.
+template <typename ParallelLoop>
+inline cost_model calibrate(ParallelLoop run_parallel,
+                            std::size_t threads = available_threads(),
+                            std::size_t n_chunks = 64) {
+  typedef std::chrono::steady_clock clock;
+  cost_model model = current_cost_model();
+
+  const std::size_t N = 400;
+  std::vector<double> x(3*N), dm(N*N);
+  for (std::size_t i = 0; i < x.size(); ++i)
+    x[i] = double((i*7919) % 101);
+
+  // Best of a few runs, to stay clear of interruptions
+  double best = 1e300;
+  for (int rep = 0; rep < 3; ++rep) {
+    clock::time_point t0 = clock::now();
+    distance_rows(x.data(), N, metric_din99d, dm.data(), 0, N);
+    best = std::min(best, std::chrono::duration<double, std::nano>(
+      clock::now() - t0).count());
+  }
+  model.ns_per_distance = best/(0.5*N*(N - 1));
+
+  // One chunk per thread approximates the startup, and the chunks beyond
+  // that the cost of handing them out
+  double few = 1e300, many = 1e300;
+  for (int rep = 0; rep < 5; ++rep) {
+    clock::time_point t0 = clock::now();
+    run_parallel(threads);
+    clock::time_point t1 = clock::now();
+    run_parallel(threads + n_chunks);
+    clock::time_point t2 = clock::now();
+    few = std::min(few, std::chrono::duration<double, std::nano>(t1 - t0).count());
+    many = std::min(many, std::chrono::duration<double, std::nano>(t2 - t1).count());
+  }
+  model.ns_startup = few;
+  model.ns_per_chunk = std::max(0.0, (many - few)/n_chunks);
+
+  return model;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_COST_MODEL_H
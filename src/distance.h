@@ -0,0 +1,169 @@
+// Color differences between DIN99d coordinates for the native engine.
+
+#ifndef QUALPALR_DISTANCE_H
+#define QUALPALR_DISTANCE_H
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+enum distance_metric {
+  metric_din99d,    // power-transformed DIN99d, as in qualpal()
+  metric_euclidean  // plain Euclidean distance in DIN99d space
+};
+
+inline bool parse_metric(const std::string& name, distance_metric& out) {
+  if (name == "din99d")
+    out = metric_din99d;
+  else if (name == "euclidean")
+    out = metric_euclidean;
+  else
+    return false;
+  return true;
+}
+
+// Delta E DIN99d with the power transformation of Huang et al. 2015, as
+// computed by edist(); a and b point to three coordinates each
+inline double din99d_distance(const double* a, const double* b) {
+  double out = 0;
+  for (int k = 0; k < 3; ++k)
+    out += std::pow(a[k] - b[k], 2);
+
+  return std::pow(std::sqrt(out), 0.74)*1.28;
+}
+
+inline double euclidean_distance(const double* a, const double* b) {
+  double out = 0;
+  for (int k = 0; k < 3; ++k)
+    out += (a[k] - b[k])*(a[k] - b[k]);
+
+  return std::sqrt(out);
+}
+
+// CIEDE2000 color difference (kL = kC = kH = 1) between CIELAB colors, after
+// Sharma, Wu, and Dalal 2005. It is not a metric: the triangle inequality
+// can fail by up to a factor of about two.
+inline double ciede2000_distance(const double* lab1, const double* lab2) {
+  const double pi = 3.14159265358979323846;
+  const double deg = pi/180;
+  const double p7 = 6103515625.0;  // 25^7
+
+  const double C1 = std::sqrt(lab1[1]*lab1[1] + lab1[2]*lab1[2]);
+  const double C2 = std::sqrt(lab2[1]*lab2[1] + lab2[2]*lab2[2]);
+  const double C7 = std::pow((C1 + C2)/2, 7);
+  const double G = 0.5*(1 - std::sqrt(C7/(C7 + p7)));
+
+  const double a1 = (1 + G)*lab1[1], a2 = (1 + G)*lab2[1];
+  const double C1p = std::sqrt(a1*a1 + lab1[2]*lab1[2]);
+  const double C2p = std::sqrt(a2*a2 + lab2[2]*lab2[2]);
+  double h1 = (a1 == 0 && lab1[2] == 0) ? 0 : std::atan2(lab1[2], a1);
+  double h2 = (a2 == 0 && lab2[2] == 0) ? 0 : std::atan2(lab2[2], a2);
+  if (h1 < 0)
+    h1 += 2*pi;
+  if (h2 < 0)
+    h2 += 2*pi;
+
+  const bool chromatic = C1p*C2p != 0;
+  double dh = 0, hb = h1 + h2;
+  if (chromatic) {
+    dh = h2 - h1;
+    if (dh > pi)
+      dh -= 2*pi;
+    else if (dh < -pi)
+      dh += 2*pi;
+
+    if (std::fabs(h1 - h2) > pi)
+      hb += hb < 2*pi ? 2*pi : -2*pi;
+    hb /= 2;
+  }
+
+  const double dL = lab2[0] - lab1[0];
+  const double dC = C2p - C1p;
+  const double dH = 2*std::sqrt(C1p*C2p)*std::sin(dh/2);
+
+  const double Lb = (lab1[0] + lab2[0])/2, Cb = (C1p + C2p)/2;
+  const double T = 1 - 0.17*std::cos(hb - 30*deg) + 0.24*std::cos(2*hb) +
+    0.32*std::cos(3*hb + 6*deg) - 0.20*std::cos(4*hb - 63*deg);
+  const double dtheta = 30*deg*std::exp(-std::pow((hb/deg - 275)/25, 2));
+  const double Cb7 = std::pow(Cb, 7);
+  const double RC = 2*std::sqrt(Cb7/(Cb7 + p7));
+  const double SL = 1 + 0.015*(Lb - 50)*(Lb - 50)/
+    std::sqrt(20 + (Lb - 50)*(Lb - 50));
+  const double SC = 1 + 0.045*Cb;
+  const double SH = 1 + 0.015*Cb*T;
+  const double RT = -std::sin(2*dtheta)*RC;
+
+  const double l = dL/SL, c = dC/SC, h = dH/SH;
+  return std::sqrt(l*l + c*c + h*h + RT*c*h);
+}
+
+inline double color_distance(distance_metric metric,
+                             const double* a,
+                             const double* b) {
+  return metric == metric_din99d ? din99d_distance(a, b)
+                                 : euclidean_distance(a, b);
+}
+
+// Fill columns [begin, end) of the lower triangle of the N x N distance
+// matrix (column-major) of the row-major coordinates x, mirroring each
+// value into the upper triangle
+inline void distance_rows(const double* x,
+                          std::size_t N,
+                          distance_metric metric,
+                          double* dm,
+                          std::size_t begin,
+                          std::size_t end) {
+  QUALPAL_TRACE_SPAN("distance_rows");
+
+  for (std::size_t i = begin; i < end; ++i) {
+    dm[i + i*N] = 0;
+    for (std::size_t j = 0; j < i; ++j) {
+      double d = color_distance(metric, x + 3*i, x + 3*j);
+      dm[i + j*N] = d;
+      dm[j + i*N] = d;
+    }
+  }
+}
+
+struct distance_task {
+  const double* x;
+  std::size_t N;
+  distance_metric metric;
+  double* dm;
+
+  void operator()(std::size_t begin, std::size_t end) const {
+    distance_rows(x, N, metric, dm, begin, end);
+  }
+};
+
+// The full distance matrix of N colors, computed on `pool` if given
+inline std::vector<double> distance_matrix(const std::vector<double>& x,
+                                           thread_pool* pool = 0,
+                                           std::size_t grain = 64,
+                                           distance_metric metric = metric_din99d) {
+  QUALPAL_TRACE_SPAN("distance_matrix");
+  stats_timer timer(stats_distances);
+
+  const std::size_t N = x.size()/3;
+  std::vector<double> dm(N*N);
+  stats_add(stats_bytes_allocated, dm.size()*sizeof(double));
+  distance_task task = {x.data(), N, metric, dm.data()};
+
+  if (pool)
+    pool->parallel_for(N, grain, task);
+  else
+    task(0, N);
+
+  return dm;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_DISTANCE_H
@@ -0,0 +1,190 @@
+// Divide-and-conquer farthest points for candidate sets far too large for a
+// single N x N distance matrix.
+//
+// The candidates are split into regions of at most `region_size` colors by
+// a k-d tree in DIN99d space (halving the widest extent of each region at
+// its median). Every region then gets its own farthest points search for n
+// colors, and the regional winners form a reduced candidate set. Rounds are
+// repeated until the candidates fit into a single region, and a last global
+// search picks the palette among them. Since the searches favor colors at
+// the edges of their regions, the winners keep the extent of the whole set
+// and the result is close to that of a global search, at a memory cost of
+// region_size^2 distances per thread instead of N^2.
+
+#ifndef QUALPALR_DIVIDE_CONQUER_H
+#define QUALPALR_DIVIDE_CONQUER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "distance.h"
+#include "farthest_points.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct divide_options {
+  std::size_t region_size;  // candidates per region (at least 4n is used)
+  distance_metric metric;
+
+  divide_options() : region_size(1024), metric(metric_din99d) {}
+};
+
+// Split the candidates `ind` (indices into the row-major coordinates x) into
+// consecutive ranges of at most `size` elements that are compact in space
+inline std::vector<std::pair<std::size_t, std::size_t> >
+kd_regions(const double* x, std::vector<std::size_t>& ind, std::size_t size) {
+  std::vector<std::pair<std::size_t, std::size_t> > out, stack;
+  stack.push_back(std::make_pair(std::size_t(0), ind.size()));
+
+  while (!stack.empty()) {
+    const std::size_t begin = stack.back().first;
+    const std::size_t end = stack.back().second;
+    stack.pop_back();
+
+    if (end - begin <= size) {
+      out.push_back(std::make_pair(begin, end));
+      continue;
+    }
+
+    double lo[3], hi[3];
+    for (int k = 0; k < 3; ++k)
+      lo[k] = hi[k] = x[3*ind[begin] + k];
+    for (std::size_t i = begin + 1; i < end; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        lo[k] = std::min(lo[k], x[3*ind[i] + k]);
+        hi[k] = std::max(hi[k], x[3*ind[i] + k]);
+      }
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+      if (hi[k] - lo[k] > hi[axis] - lo[axis])
+        axis = k;
+
+    // Ties go by index, so that the split does not depend on the input order
+    const std::size_t mid = begin + (end - begin)/2;
+    std::nth_element(ind.begin() + begin, ind.begin() + mid, ind.begin() + end,
+                     [x, axis](std::size_t a, std::size_t b) {
+                       const double xa = x[3*a + axis], xb = x[3*b + axis];
+                       return xa < xb || (xa == xb && a < b);
+                     });
+
+    stack.push_back(std::make_pair(mid, end));
+    stack.push_back(std::make_pair(begin, mid));
+  }
+
+  return out;
+}
+
+// The n most distinct of the candidates `ind`, as indices into x
+inline std::vector<std::size_t> region_farthest_points(const double* x,
+                                                       const std::size_t* ind,
+                                                       std::size_t m,
+                                                       std::size_t n,
+                                                       const search_options& opts,
+                                                       distance_metric metric,
+                                                       search_diagnostics& diag) {
+  QUALPAL_TRACE_SPAN("region_farthest_points");
+
+  if (m < n)
+    return std::vector<std::size_t>(ind, ind + m);
+
+  std::vector<double> lab(3*m);
+  for (std::size_t i = 0; i < m; ++i)
+    std::copy(x + 3*ind[i], x + 3*ind[i] + 3, &lab[3*i]);
+  std::vector<double> dm = distance_matrix(lab, 0, m, metric);
+
+  std::vector<std::size_t> r;
+  {
+    arena_scope scratch(thread_arena(), search_scratch_bytes(m, n, opts));
+    r = farthest_points(dm.data(), m, n, opts, diag);
+  }
+
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = ind[r[i]];
+  return r;
+}
+
+// Select n maximally distinct colors among the N colors with row-major
+// coordinates x (3N values), solving the regions of each round by calling
+// run_parallel(n_regions, f), which must call f(begin, end) for ranges of
+// regions covering [0, n_regions)
+template <typename ParallelFor>
+inline std::vector<std::size_t> divide_farthest_points(const double* x,
+                                                       std::size_t N,
+                                                       std::size_t n,
+                                                       const search_options& opts,
+                                                       const divide_options& dopts,
+                                                       search_diagnostics& diag,
+                                                       std::size_t& n_regions,
+                                                       ParallelFor run_parallel) {
+  QUALPAL_TRACE_SPAN("divide_farthest_points");
+  stats_add(stats_calls_divide);
+
+  // Each round has to shrink the candidates substantially
+  const std::size_t size = std::max(dopts.region_size, 4*n);
+
+  std::vector<std::size_t> ind(N);
+  for (std::size_t i = 0; i < N; ++i)
+    ind[i] = i;
+
+  n_regions = 0;
+  while (ind.size() > size) {
+    std::vector<std::pair<std::size_t, std::size_t> > regions =
+      kd_regions(x, ind, size);
+    std::vector<std::vector<std::size_t> > winners(regions.size());
+    std::vector<search_diagnostics> diags(regions.size());
+
+    run_parallel(regions.size(), [&](std::size_t begin, std::size_t end) {
+      for (std::size_t k = begin; k < end; ++k)
+        winners[k] = region_farthest_points(
+          x, &ind[regions[k].first], regions[k].second - regions[k].first,
+          n, opts, dopts.metric, diags[k]);
+    });
+
+    std::vector<std::size_t> next;
+    for (std::size_t k = 0; k < regions.size(); ++k) {
+      next.insert(next.end(), winners[k].begin(), winners[k].end());
+      accumulate(diag, diags[k]);
+    }
+    std::sort(next.begin(), next.end());
+
+    n_regions += regions.size();
+    ind.swap(next);
+
+    if (diag.cancelled) {
+      stats_add_outcome(diag);
+      return std::vector<std::size_t>();
+    }
+  }
+
+  std::vector<std::size_t> r =
+    region_farthest_points(x, ind.data(), ind.size(), n, opts, dopts.metric,
+                           diag);
+  n_regions += 1;
+  stats_add_outcome(diag);
+  return r;
+}
+
+// Divide and conquer on a thread pool (or on the calling thread if null)
+inline std::vector<std::size_t> divide_farthest_points(const double* x,
+                                                       std::size_t N,
+                                                       std::size_t n,
+                                                       const search_options& opts,
+                                                       const divide_options& dopts,
+                                                       search_diagnostics& diag,
+                                                       std::size_t& n_regions,
+                                                       thread_pool* pool = 0) {
+  const pool_loop loop = {pool, 1};
+  return divide_farthest_points(x, N, n, opts, dopts, diag, n_regions, loop);
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_DIVIDE_CONQUER_H
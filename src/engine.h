@@ -0,0 +1,534 @@
+// The native palette engine: the whole qualpal() pipeline (candidate
+// colors, color vision deficiency simulation, DIN99d conversion, distances,
+// and the farthest points search) without R.
+//
+// Candidate colors and their distance matrices depend only on the color
+// space and the color vision deficiency settings, so the engine keeps the
+// most recently used ones around and shares them between requests.
+//
+// The engine is reentrant: it keeps no global state of its own, candidate
+// sets are immutable once built and are shared by reference count, and the
+// scratch memory of a search comes from the calling thread's arena. Any
+// number of threads may call generate() on the same engine, or
+// select_palette() on the same candidate set, at once.
+
+#ifndef QUALPALR_ENGINE_H
+#define QUALPALR_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "color_conversion.h"
+#include "cost_model.h"
+#include "distance.h"
+#include "farthest_points.h"
+#include "hash.h"
+#include "knn_graph.h"
+#include "locality.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct palette_request {
+  std::size_t n;
+
+  // The colors to choose from: either n_points colors sampled from an HSL
+  // box, or explicit sRGB colors (row-major, three per color)
+  bool use_box;
+  hsl_box box;
+  std::size_t n_points;
+  std::vector<double> candidates;
+
+  // Color vision deficiency to adapt to; a severity of 0 turns it off
+  cvd_type cvd;
+  double cvd_severity;
+
+  // sRGB colors (row-major) that have to be part of the palette
+  std::vector<double> fixed;
+
+  distance_metric metric;
+  search_options search;
+
+  palette_request()
+    : n(0),
+      use_box(true),
+      n_points(1000),
+      cvd(cvd_protan),
+      cvd_severity(0),
+      metric(metric_din99d) {
+    predefined_colorspace("pretty", box);
+  }
+};
+
+// Candidate colors and everything derived from them. The colors are stored
+// in Morton order (see locality.h); `order` maps them back to the order of
+// the request. The neighbour graph is only built for the local strategy.
+struct candidate_set {
+  std::vector<double> rgb;     // as simulated for color vision deficiency
+  std::vector<double> din99d;
+  std::vector<double> dm;      // column-major distance matrix
+  candidate_order order;
+  knn_graph neighbors;
+
+  std::size_t size() const { return rgb.size()/3; }
+};
+
+struct palette_result {
+  std::vector<std::size_t> indices;  // into the candidates, fixed colors last
+  std::vector<std::string> hex;
+  std::vector<double> rgb;
+  std::vector<double> din99d;
+  double min_de;
+  double cvd_severity;
+  bool cache_hit;
+  search_diagnostics diagnostics;
+
+  // Scratch buffers served by the thread's arena, and the blocks the arena
+  // had to get from the heap for them (zero once it is warm)
+  std::size_t scratch_allocations;
+  std::size_t scratch_blocks;
+
+  palette_result()
+    : min_de(0),
+      cvd_severity(0),
+      cache_hit(false),
+      scratch_allocations(0),
+      scratch_blocks(0) {}
+};
+
+inline std::string candidate_key(const palette_request& req) {
+  char buf[256];
+  std::string key;
+
+  if (req.use_box) {
+    std::snprintf(buf, sizeof(buf), "box %.17g %.17g %.17g %.17g %.17g %.17g %lu",
+                  req.box.h[0], req.box.h[1], req.box.s[0], req.box.s[1],
+                  req.box.l[0], req.box.l[1],
+                  static_cast<unsigned long>(req.n_points));
+  } else {
+    std::snprintf(buf, sizeof(buf), "rgb %s %lu",
+                  hash_hex(fnv1a(req.candidates.data(),
+                                 req.candidates.size()*sizeof(double))).c_str(),
+                  static_cast<unsigned long>(req.candidates.size()/3));
+  }
+  key += buf;
+
+  if (req.metric != metric_din99d) {
+    std::snprintf(buf, sizeof(buf), " metric %d", static_cast<int>(req.metric));
+    key += buf;
+  }
+
+  if (req.cvd_severity > 0) {
+    std::snprintf(buf, sizeof(buf), " cvd %d %.17g",
+                  static_cast<int>(req.cvd), req.cvd_severity);
+    key += buf;
+  }
+
+  if (req.search.strategy == swap_local) {
+    std::snprintf(buf, sizeof(buf), " knn %lu",
+                  static_cast<unsigned long>(req.search.n_neighbors));
+    key += buf;
+  }
+
+  return key;
+}
+
+// Convert sRGB colors to (simulated) sRGB and DIN99d coordinates
+inline void convert_colors(const std::vector<double>& rgb,
+                           cvd_type cvd,
+                           double cvd_severity,
+                           std::vector<double>& simulated,
+                           std::vector<double>& din99d) {
+  QUALPAL_TRACE_SPAN("conversion");
+  stats_timer timer(stats_conversion);
+
+  const std::size_t N = rgb.size()/3;
+  double mat[3][3];
+  const bool simulate = cvd_severity > 0;
+
+  if (simulate)
+    cvd_simulation_matrix(cvd, cvd_severity, mat);
+
+  simulated.resize(3*N);
+  din99d.resize(3*N);
+
+  for (std::size_t i = 0; i < N; ++i) {
+    double xyz[3];
+    if (simulate)
+      simulate_cvd(mat, &rgb[3*i], &simulated[3*i]);
+    else
+      std::copy(&rgb[3*i], &rgb[3*i] + 3, &simulated[3*i]);
+    rgb_xyz(&simulated[3*i], xyz);
+    xyz_din99d(xyz, &din99d[3*i]);
+  }
+}
+
+// Build the candidate set of a request, with the distance matrix on `pool`
+// (or on this thread if null) when `model` says that pays off
+inline std::shared_ptr<const candidate_set>
+make_candidates(const palette_request& req,
+                thread_pool* pool,
+                const cost_model& model = current_cost_model()) {
+  std::shared_ptr<candidate_set> out = std::make_shared<candidate_set>();
+  std::vector<double> rgb;
+
+  if (req.use_box) {
+    std::vector<double> hsl = sample_hsl(req.box, req.n_points);
+    rgb.resize(hsl.size());
+    for (std::size_t i = 0; i < req.n_points; ++i)
+      hsl_rgb(&hsl[3*i], &rgb[3*i]);
+  } else {
+    rgb = req.candidates;
+  }
+
+  std::vector<double> simulated, din99d;
+  convert_colors(rgb, req.cvd, req.cvd_severity, simulated, din99d);
+
+  out->order = morton_order(din99d);
+  out->rgb = permute_rows(simulated, out->order.order);
+  out->din99d = permute_rows(din99d, out->order.order);
+
+  // Small candidate sets are cheaper to finish on this thread than to
+  // hand out to the pool
+  const parallel_plan plan = model.plan_distances(
+    out->din99d.size()/3, pool ? pool->size() + 1 : 1);
+  out->dm = distance_matrix(out->din99d, plan.parallel() ? pool : 0,
+                            plan.grain, req.metric);
+
+  if (req.search.strategy == swap_local)
+    out->neighbors = make_knn_graph(out->din99d.data(), out->size(),
+                                    req.search.n_neighbors,
+                                    plan.parallel() ? pool : 0);
+
+  return out;
+}
+
+// Append colors to a candidate set, reusing its distance matrix (the
+// neighbour graph, if any, is rebuilt)
+inline std::shared_ptr<const candidate_set>
+extend_candidates(const candidate_set& base,
+                  const std::vector<double>& rgb,
+                  cvd_type cvd,
+                  double cvd_severity,
+                  distance_metric metric) {
+  std::shared_ptr<candidate_set> out = std::make_shared<candidate_set>();
+  std::vector<double> simulated, din99d;
+  convert_colors(rgb, cvd, cvd_severity, simulated, din99d);
+
+  out->rgb = base.rgb;
+  out->rgb.insert(out->rgb.end(), simulated.begin(), simulated.end());
+  out->din99d = base.din99d;
+  out->din99d.insert(out->din99d.end(), din99d.begin(), din99d.end());
+  out->order = base.order;
+  out->order.extend(din99d.size()/3);
+
+  const std::size_t N0 = base.size(), N = out->size();
+  out->dm.assign(N*N, 0.0);
+
+  for (std::size_t j = 0; j < N0; ++j)
+    std::copy(&base.dm[j*N0], &base.dm[j*N0] + N0, &out->dm[j*N]);
+
+  for (std::size_t i = N0; i < N; ++i) {
+    for (std::size_t j = 0; j < i; ++j) {
+      double d = color_distance(metric, &out->din99d[3*i], &out->din99d[3*j]);
+      out->dm[i + j*N] = d;
+      out->dm[j + i*N] = d;
+    }
+  }
+
+  if (!base.neighbors.empty())
+    out->neighbors = make_knn_graph(out->din99d.data(), N, base.neighbors.k);
+
+  return out;
+}
+
+// A thread-safe least-recently-used cache of candidate sets
+class candidate_cache {
+public:
+  explicit candidate_cache(std::size_t capacity = 16)
+    : capacity(capacity), hits(0), misses(0) {}
+
+  std::shared_ptr<const candidate_set> get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, entry>::iterator it = entries.find(key);
+    if (it == entries.end()) {
+      misses++;
+      stats_add(stats_candidate_misses);
+      return std::shared_ptr<const candidate_set>();
+    }
+    hits++;
+    stats_add(stats_candidate_hits);
+    order.splice(order.begin(), order, it->second.position);
+    return it->second.value;
+  }
+
+  void put(const std::string& key,
+           const std::shared_ptr<const candidate_set>& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (capacity == 0 || entries.count(key))
+      return;
+
+    order.push_front(key);
+    entry e = {value, order.begin()};
+    entries[key] = e;
+
+    while (entries.size() > capacity) {
+      entries.erase(order.back());
+      order.pop_back();
+    }
+  }
+
+  std::size_t hit_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+  }
+
+  std::size_t miss_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+  }
+
+private:
+  struct entry {
+    std::shared_ptr<const candidate_set> value;
+    std::list<std::string>::iterator position;
+  };
+
+  std::size_t capacity;
+  std::size_t hits, misses;
+  mutable std::mutex mutex;
+  std::list<std::string> order;
+  std::map<std::string, entry> entries;
+};
+
+// The most candidate colors a request may have, so that their indices fit
+// in 16 bits like those of the precomputed palettes
+const std::size_t max_candidates = 65535;
+
+// Check a request before any work is done for it; `max_points` bounds the
+// number of candidate colors, and with it the size of the distance matrix
+inline void validate(const palette_request& req,
+                     std::size_t max_points = max_candidates) {
+  if (req.n < 2)
+    throw std::invalid_argument("n must be at least 2");
+  if (req.cvd_severity < 0 || req.cvd_severity > 1)
+    throw std::invalid_argument("cvd_severity must be in [0, 1]");
+  if (req.fixed.size() % 3 != 0 || req.candidates.size() % 3 != 0)
+    throw std::invalid_argument("colors must have three components");
+  if (req.fixed.size()/3 > req.n)
+    throw std::invalid_argument("more fixed colors than n");
+
+  if (req.use_box) {
+    const hsl_box& b = req.box;
+    if (b.h[1] - b.h[0] > 360 || b.h[0] < -360 || b.h[1] > 360 ||
+        b.s[0] < 0 || b.s[1] > 1 || b.l[0] < 0 || b.l[1] > 1)
+      throw std::invalid_argument("invalid HSL color space");
+  } else {
+    for (std::size_t i = 0; i < req.candidates.size(); ++i)
+      if (!(req.candidates[i] >= 0 && req.candidates[i] <= 1))
+        throw std::invalid_argument("sRGB colors must be in [0, 1]");
+  }
+
+  const std::size_t N =
+    (req.use_box ? req.n_points : req.candidates.size()/3) + req.fixed.size()/3;
+  if (req.n > N)
+    throw std::invalid_argument("n exceeds the number of candidate colors");
+  const std::size_t limit = std::min(max_points, max_candidates);
+  if (N > limit)
+    throw std::invalid_argument("more than " + std::to_string(limit) +
+                                " candidate colors");
+}
+
+// Run the search on a candidate set and collect the result. Fixed colors,
+// if any, are the last `n_fixed` candidates. The search starts from and
+// breaks ties by the original order of the candidates, so the result does
+// not depend on how they are stored.
+inline palette_result select_palette(const candidate_set& cs,
+                                     std::size_t n,
+                                     std::size_t n_fixed,
+                                     search_options opts) {
+  const std::size_t N = cs.size();
+  palette_result out;
+
+  opts.n_fixed = n_fixed;
+  opts.tie_rank = cs.order.order.data();
+  if (opts.strategy == swap_local && !cs.neighbors.empty()) {
+    opts.neighbors = cs.neighbors.neighbors.data();
+    opts.n_neighbors = cs.neighbors.k;
+  }
+  const std::size_t blocks = thread_arena().block_allocations();
+  arena_scope scratch(thread_arena(), search_scratch_bytes(N, n, opts));
+
+  std::vector<std::size_t> r;
+  r.reserve(n);
+  for (std::size_t i = 0; i < n_fixed; ++i)
+    r.push_back(N - n_fixed + i);
+
+  std::vector<std::size_t> rest = initial_selection(N - n_fixed, n - n_fixed);
+  for (std::size_t i = 0; i < rest.size(); ++i)
+    r.push_back(cs.order.rank[rest[i]]);
+
+  swap_search(cs.dm.data(), N, r, opts, out.diagnostics);
+  const std::vector<std::size_t> ordered = order_selection(cs.dm.data(), N, r);
+  stats_add(stats_calls_global);
+  stats_add_outcome(out.diagnostics);
+
+  out.hex.reserve(n);
+  out.rgb.reserve(3*n);
+  out.din99d.reserve(3*n);
+
+  out.min_de = std::numeric_limits<double>::infinity();
+  out.indices.reserve(n);
+  for (std::size_t a = 0; a < n; ++a) {
+    const std::size_t i = ordered[a];
+    out.indices.push_back(cs.order.order[i]);
+    out.hex.push_back(rgb_hex(&cs.rgb[3*i]));
+    out.rgb.insert(out.rgb.end(), &cs.rgb[3*i], &cs.rgb[3*i] + 3);
+    out.din99d.insert(out.din99d.end(), &cs.din99d[3*i], &cs.din99d[3*i] + 3);
+    for (std::size_t b = 0; b < a; ++b)
+      out.min_de = std::min(out.min_de, dist_at(cs.dm.data(), N, i, ordered[b]));
+  }
+
+  out.scratch_allocations = thread_arena().allocations();
+  out.scratch_blocks = thread_arena().block_allocations() - blocks;
+
+  return out;
+}
+
+class engine {
+public:
+  // The engine plans its parallel loops with a copy of `model`, so that
+  // requests do not contend for the global one
+  explicit engine(std::size_t n_threads = 0,
+                  std::size_t cache_capacity = 16,
+                  const cost_model& model = current_cost_model())
+    : workers(n_threads), cache(cache_capacity), model(model),
+      max_points(max_candidates) {}
+
+  thread_pool& pool() { return workers; }
+
+  // Reject requests with more than `n` candidate colors (at most
+  // max_candidates); set before the engine is shared
+  void limit_candidates(std::size_t n) { max_points = n; }
+
+  std::shared_ptr<const candidate_set> candidates(const palette_request& req,
+                                                  bool& cache_hit) {
+    const std::string key = candidate_key(req);
+    std::shared_ptr<const candidate_set> cs = cache.get(key);
+    cache_hit = bool(cs);
+    if (!cs) {
+      cs = make_candidates(req, &workers, model);
+      cache.put(key, cs);
+    }
+    return cs;
+  }
+
+  palette_result generate(const palette_request& req) {
+    QUALPAL_TRACE_SPAN("generate");
+    stats_timer timer(stats_total);
+
+    validate(req, max_points);
+
+    bool hit = false;
+    std::shared_ptr<const candidate_set> cs = candidates(req, hit);
+
+    const std::size_t n_fixed = req.fixed.size()/3;
+    if (n_fixed > 0)
+      cs = extend_candidates(*cs, req.fixed, req.cvd, req.cvd_severity,
+                             req.metric);
+
+    palette_result out = select_palette(*cs, req.n, n_fixed, req.search);
+    out.cvd_severity = req.cvd_severity;
+    out.cache_hit = hit;
+    return out;
+  }
+
+  // The native counterpart of autopal(): find the color vision deficiency
+  // severity whose palette comes closest to a smallest color difference of
+  // `target`, by golden-section search on the squared deviation over
+  // [0, 1]. The tolerance matches the default of stats::optimize().
+  palette_result autopal(palette_request req,
+                         double target,
+                         double tol = 1.220703125e-4) {
+    QUALPAL_TRACE_SPAN("autopal");
+
+    const double ratio = (std::sqrt(5.0) - 1)/2;
+    double a = 0, b = 1;
+    double x1 = b - ratio*(b - a), x2 = a + ratio*(b - a);
+
+    autopal_search search(target);
+    double f1 = autopal_cost(req, x1, search);
+    double f2 = autopal_cost(req, x2, search);
+
+    while (b - a > tol) {
+      if (f1 <= f2) {
+        b = x2;
+        x2 = x1;
+        f2 = f1;
+        x1 = b - ratio*(b - a);
+        f1 = autopal_cost(req, x1, search);
+      } else {
+        a = x1;
+        x1 = x2;
+        f1 = f2;
+        x2 = a + ratio*(b - a);
+        f2 = autopal_cost(req, x2, search);
+      }
+    }
+
+    search.best.cache_hit = search.all_hits;
+    return search.best;
+  }
+
+  const candidate_cache& artifacts() const { return cache; }
+
+private:
+  // The best palette seen during an autopal() search
+  struct autopal_search {
+    double target;
+    palette_result best;
+    double best_cost;
+    bool all_hits;
+
+    explicit autopal_search(double target)
+      : target(target),
+        best_cost(std::numeric_limits<double>::infinity()),
+        all_hits(true) {}
+  };
+
+  double autopal_cost(palette_request& req, double severity,
+                      autopal_search& search) {
+    req.cvd_severity = severity;
+    palette_result res = generate(req);
+    search.all_hits = search.all_hits && res.cache_hit;
+
+    const double cost = (res.min_de - search.target)*(res.min_de - search.target);
+    if (cost < search.best_cost) {
+      search.best_cost = cost;
+      search.best = res;
+    }
+    return cost;
+  }
+
+  thread_pool workers;
+  candidate_cache cache;
+  const cost_model model;
+  std::size_t max_points;
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_ENGINE_H
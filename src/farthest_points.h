@@ -0,0 +1,801 @@
+// Farthest point optimization on a precomputed distance matrix.
+//
+// Everything in here uses the standard library only, so that the search can
+// be shared between the Rcpp interface in qualpal.cpp and native code that
+// does not link against R. Distance matrices are symmetric, N x N, and stored
+// in column-major order (as in R), so that column j of the matrix is
+// contiguous in memory.
+
+#ifndef QUALPALR_FARTHEST_POINTS_H
+#define QUALPALR_FARTHEST_POINTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "arena.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace qualpal {
+
+// How the swap step looks for the best replacement of a selected point
+enum swap_strategy {
+  // Evaluate the distance from every excluded candidate to every selected
+  // point (the original brute-force scan)
+  swap_scan,
+  // Skip candidates whose pivot-based upper bound on the distance to the
+  // selection cannot beat the best replacement found so far, and abandon
+  // the remaining ones as soon as they come too close to the selection
+  swap_pruned,
+  // Keep every candidate's nearest and second-nearest selected points up to
+  // date and find the best replacement from indexed max-heaps keyed by them
+  swap_heap,
+  // Only consider the nearest candidates of each selected point (see
+  // search_options::neighbors) as its replacement, and fall back to a pass
+  // of the pruned strategy over all candidates whenever that stops
+  // improving; without neighbours, the same as swap_pruned
+  swap_local
+};
+
+struct search_options {
+  swap_strategy strategy;
+  std::size_t n_pivots;
+  std::size_t n_fixed;  // leading entries of the selection to keep as is
+  double time_budget;   // seconds; the search stops early once exceeded (0: no limit)
+
+  // Passes after which to give up. Ties between equally distant candidates
+  // (duplicate colors, for instance) can make the swaps cycle forever.
+  std::size_t max_iterations;
+
+  // Set by another thread to stop the search early (may be null)
+  const std::atomic<bool>* cancel;
+
+  // The rank of every candidate when breaking ties between equally distant
+  // ones, for candidates that have been reordered (see locality.h); null
+  // breaks ties by index
+  const std::size_t* tie_rank;
+
+  // The n_neighbors nearest candidates of every candidate (row-major, see
+  // knn_graph.h) for the local strategy; callers that build the graph take
+  // its size from n_neighbors
+  const std::size_t* neighbors;
+  std::size_t n_neighbors;
+
+  search_options()
+    : strategy(swap_heap),
+      n_pivots(8),
+      n_fixed(0),
+      time_budget(0),
+      max_iterations(1000),
+      cancel(0),
+      tie_rank(0),
+      neighbors(0),
+      n_neighbors(16) {}
+};
+
+// Whether candidate a wins a tie against candidate b
+inline bool tie_before(const std::size_t* tie_rank,
+                       std::size_t a,
+                       std::size_t b) {
+  return tie_rank ? tie_rank[a] < tie_rank[b] : a < b;
+}
+
+struct search_diagnostics {
+  std::size_t iterations;  // passes over the selection
+  std::size_t candidates;  // candidates considered in swap scans
+  std::size_t pruned;      // candidates skipped by the pivot bounds
+  std::size_t abandoned;   // candidates dropped midway through evaluation
+  std::size_t heap_updates; // repositionings in the candidate heaps
+  bool timed_out;          // stopped by the time budget before converging
+  bool capped;             // stopped by max_iterations before converging
+  bool cancelled;          // stopped on request
+
+  search_diagnostics()
+    : iterations(0),
+      candidates(0),
+      pruned(0),
+      abandoned(0),
+      heap_updates(0),
+      timed_out(false),
+      capped(false),
+      cancelled(false) {}
+
+  double prune_rate() const {
+    return candidates > 0 ? double(pruned) / double(candidates) : 0.0;
+  }
+};
+
+// Add the diagnostics of one search to those of several
+inline void accumulate(search_diagnostics& into,
+                       const search_diagnostics& from) {
+  into.iterations += from.iterations;
+  into.candidates += from.candidates;
+  into.pruned += from.pruned;
+  into.abandoned += from.abandoned;
+  into.heap_updates += from.heap_updates;
+  into.timed_out = into.timed_out || from.timed_out;
+  into.capped = into.capped || from.capped;
+  into.cancelled = into.cancelled || from.cancelled;
+}
+
+// Count a search that stopped early in the cumulative statistics
+inline void stats_add_outcome(const search_diagnostics& diag) {
+  if (diag.cancelled)
+    stats_add(stats_cancellations);
+  else if (diag.timed_out)
+    stats_add(stats_timeouts);
+}
+
+// Tracks the time budget and cancellation of a search. The selection is
+// valid after every slot, so stopping between slots leaves a usable (if
+// less spread out) palette.
+class search_deadline {
+public:
+  explicit search_deadline(const search_options& opts)
+    : limited(opts.time_budget > 0),
+      end(std::chrono::steady_clock::now() +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(limited ? opts.time_budget : 0))),
+      cancel(opts.cancel) {}
+
+  bool expired(search_diagnostics& diag) const {
+    if (limited && std::chrono::steady_clock::now() >= end)
+      diag.timed_out = true;
+    if (cancel && cancel->load(std::memory_order_relaxed))
+      diag.cancelled = true;
+    return diag.timed_out || diag.cancelled;
+  }
+
+private:
+  bool limited;
+  std::chrono::steady_clock::time_point end;
+  const std::atomic<bool>* cancel;
+};
+
+inline double dist_at(const double* dm, std::size_t N, std::size_t i,
+                      std::size_t j) {
+  return dm[i + j*N];
+}
+
+inline bool same_selection(const std::vector<std::size_t>& r,
+                           const scratch_vector<std::size_t>& r_old) {
+  return r.size() == r_old.size() && std::equal(r.begin(), r.end(), r_old.begin());
+}
+
+// Linearly spaced starting indices, mirroring arma::linspace<arma::uvec>
+inline std::vector<std::size_t> initial_selection(std::size_t N,
+                                                  std::size_t n) {
+  std::vector<std::size_t> r(n, N - 1);
+  if (n > 1) {
+    const double delta = double(N - 1)/double(n - 1);
+    for (std::size_t i = 0; i < n - 1; ++i)
+      r[i] = static_cast<std::size_t>(i*delta);
+  }
+  return r;
+}
+
+// Pick pivots by farthest-first traversal so that they are spread out over
+// the candidates, and tabulate the distance from every candidate to every
+// pivot in candidate-major order.
+inline void make_pivots(const double* dm,
+                        std::size_t N,
+                        std::size_t k,
+                        scratch_vector<std::size_t>& pivots,
+                        scratch_vector<double>& pivot_dist) {
+  k = std::min(k, N);
+  pivots.clear();
+  pivot_dist.assign(N*k, 0.0);
+
+  if (k == 0)
+    return;
+
+  scratch_vector<double> nearest(N, std::numeric_limits<double>::infinity());
+  std::size_t next = 0;
+
+  for (std::size_t p = 0; p < k; ++p) {
+    pivots.push_back(next);
+    const double* col = dm + next*N;
+    std::size_t farthest = 0;
+    for (std::size_t c = 0; c < N; ++c) {
+      pivot_dist[c*k + p] = col[c];
+      nearest[c] = std::min(nearest[c], col[c]);
+      if (nearest[c] > nearest[farthest])
+        farthest = c;
+    }
+    next = farthest;
+  }
+}
+
+// A binary max-heap over candidate indices, ordered by an external key
+// array (ties go to the lower index, or rank if given). Positions are
+// tracked in an external array too, so that several heaps can partition the
+// same candidates and keys can be changed in place.
+class indexed_heap {
+public:
+  indexed_heap(const scratch_vector<double>& key,
+               scratch_vector<std::size_t>& pos,
+               const std::size_t* tie_rank = 0)
+    : key(&key), pos(&pos), tie_rank(tie_rank) {}
+
+  bool before(std::size_t a, std::size_t b) const {
+    const double ka = (*key)[a], kb = (*key)[b];
+    return ka > kb || (ka == kb && tie_before(tie_rank, a, b));
+  }
+
+  std::size_t size() const { return items.size(); }
+
+  void push(std::size_t c) {
+    (*pos)[c] = items.size();
+    items.push_back(c);
+    sift_up(items.size() - 1);
+  }
+
+  void remove(std::size_t c) {
+    std::size_t p = (*pos)[c];
+    std::size_t last = items.back();
+    items.pop_back();
+    if (p < items.size()) {
+      items[p] = last;
+      (*pos)[last] = p;
+      update(last);
+    }
+  }
+
+  // Restore the heap property after the key of c has changed
+  void update(std::size_t c) {
+    sift_down(sift_up((*pos)[c]));
+  }
+
+  // Return the first item, in heap order, for which skip(item) is false and
+  // which comes before `best` (pass a value >= the number of candidates to
+  // accept any item). Subtrees that cannot hold such an item are not visited.
+  template <typename Skip>
+  std::size_t best_unless(const Skip& skip,
+                          std::size_t best,
+                          std::size_t& visited) const {
+    const std::size_t N = pos->size();
+    scratch_vector<std::size_t>& stack = scratch;
+    stack.clear();
+    if (!items.empty())
+      stack.push_back(0);
+
+    while (!stack.empty()) {
+      std::size_t p = stack.back();
+      stack.pop_back();
+      std::size_t c = items[p];
+
+      if (best < N && !before(c, best))
+        continue;
+
+      visited++;
+
+      if (!skip(c))
+        best = c;
+
+      if (2*p + 2 < items.size())
+        stack.push_back(2*p + 2);
+      if (2*p + 1 < items.size())
+        stack.push_back(2*p + 1);
+    }
+
+    return best;
+  }
+
+private:
+  std::size_t sift_up(std::size_t p) {
+    while (p > 0) {
+      std::size_t parent = (p - 1)/2;
+      if (!before(items[p], items[parent]))
+        break;
+      swap_items(p, parent);
+      p = parent;
+    }
+    return p;
+  }
+
+  void sift_down(std::size_t p) {
+    for (;;) {
+      std::size_t l = 2*p + 1, r = l + 1, top = p;
+      if (l < items.size() && before(items[l], items[top]))
+        top = l;
+      if (r < items.size() && before(items[r], items[top]))
+        top = r;
+      if (top == p)
+        break;
+      swap_items(p, top);
+      p = top;
+    }
+  }
+
+  void swap_items(std::size_t a, std::size_t b) {
+    std::swap(items[a], items[b]);
+    (*pos)[items[a]] = a;
+    (*pos)[items[b]] = b;
+  }
+
+  const scratch_vector<double>* key;
+  scratch_vector<std::size_t>* pos;
+  const std::size_t* tie_rank;
+  scratch_vector<std::size_t> items;
+  mutable scratch_vector<std::size_t> scratch;
+};
+
+// Nearest (d1, o1) and second-nearest (d2, o2) selected points, by slot in
+// the selection, of every candidate
+struct nearest_selected {
+  scratch_vector<double> d1, d2;
+  scratch_vector<std::size_t> o1, o2;
+
+  explicit nearest_selected(std::size_t N)
+    : d1(N), d2(N), o1(N), o2(N) {}
+
+  void recompute(const double* dm,
+                 std::size_t N,
+                 const std::vector<std::size_t>& r,
+                 std::size_t c) {
+    const double* col = dm + c*N;
+    double a = std::numeric_limits<double>::infinity(), b = a;
+    std::size_t oa = 0, ob = 0;
+    for (std::size_t j = 0; j < r.size(); ++j) {
+      double d = col[r[j]];
+      if (d < a) {
+        b = a;
+        ob = oa;
+        a = d;
+        oa = j;
+      } else if (d < b) {
+        b = d;
+        ob = j;
+      }
+    }
+    d1[c] = a;
+    o1[c] = oa;
+    d2[c] = b;
+    o2[c] = ob;
+  }
+};
+
+// Candidates are everything except the points held by other slots than the
+// one being replaced
+struct held_by_other_slot {
+  const scratch_vector<std::size_t>* count;
+  std::size_t u;
+
+  bool operator()(std::size_t c) const {
+    return (*count)[c] > (c == u ? 1u : 0u);
+  }
+};
+
+struct nearest_to_slot_or_held {
+  const nearest_selected* ns;
+  held_by_other_slot held;
+  std::size_t i;
+
+  bool operator()(std::size_t c) const {
+    return ns->o1[c] == i || held(c);
+  }
+};
+
+// Heap-based version of the swap search.
+//
+// When slot i is emptied, the distance from candidate c to the remaining
+// selection is d2[c] if slot i holds its nearest point and d1[c] otherwise.
+// One heap over all candidates is keyed by d1, and the candidates are also
+// partitioned by nearest slot into heaps keyed by d2, so the best
+// replacement for slot i is the better of the best item in cell heap i and
+// the best item in the main heap whose nearest slot is not i. Both queries
+// only visit the items that can beat the best found so far.
+//
+// After a swap, only candidates whose nearest or second-nearest point was
+// swapped out need a full recomputation (roughly 2N/n of them); for the
+// rest, the new point can only move closer, which takes one lookup in its
+// contiguous column.
+inline void swap_search_heap(const double* dm,
+                             std::size_t N,
+                             std::vector<std::size_t>& r,
+                             std::size_t n_fixed,
+                             std::size_t max_iterations,
+                             const std::size_t* tie_rank,
+                             const search_deadline& deadline,
+                             search_diagnostics& diag) {
+  const std::size_t n = r.size();
+
+  QUALPAL_TRACE_SPAN("heap_build");
+
+  nearest_selected ns(N);
+  scratch_vector<std::size_t> count(N);
+
+  for (std::size_t j = 0; j < n; ++j)
+    count[r[j]]++;
+
+  for (std::size_t c = 0; c < N; ++c)
+    ns.recompute(dm, N, r, c);
+
+  scratch_vector<std::size_t> main_pos(N), cell_pos(N);
+  indexed_heap main_heap(ns.d1, main_pos, tie_rank);
+  scratch_vector<indexed_heap> cells(n,
+                                     indexed_heap(ns.d2, cell_pos, tie_rank));
+
+  for (std::size_t c = 0; c < N; ++c) {
+    main_heap.push(c);
+    cells[ns.o1[c]].push(c);
+  }
+
+  scratch_vector<std::size_t> r_old;
+
+  do {
+    QUALPAL_TRACE_SPAN("swap_pass");
+
+    r_old.assign(r.begin(), r.end());
+    diag.iterations++;
+
+    for (std::size_t i = n_fixed; i < n; ++i) {
+      if (deadline.expired(diag))
+        return;
+
+      const std::size_t u = r[i];
+
+      held_by_other_slot held = {&count, u};
+      nearest_to_slot_or_held skip_main = {&ns, held, i};
+
+      std::size_t best = cells[i].best_unless(held, N, diag.candidates);
+      std::size_t other = main_heap.best_unless(skip_main, N, diag.candidates);
+
+      // Compare the keys that apply when slot i is emptied
+      if (other < N) {
+        const double ko = ns.d1[other];
+        const double kb = best < N ? ns.d2[best] : 0.0;
+        if (best >= N || ko > kb ||
+            (ko == kb && tie_before(tie_rank, other, best)))
+          best = other;
+      }
+
+      if (best >= N || best == u)
+        continue;
+
+      const std::size_t v = best;
+      r[i] = v;
+      count[u]--;
+      count[v]++;
+
+      const double* col = dm + v*N;
+
+      for (std::size_t c = 0; c < N; ++c) {
+        const double d1 = ns.d1[c], d2 = ns.d2[c];
+        const std::size_t o1 = ns.o1[c];
+
+        if (o1 == i || ns.o2[c] == i) {
+          ns.recompute(dm, N, r, c);
+        } else {
+          const double dv = col[c];
+          if (dv < d1) {
+            ns.d2[c] = d1;
+            ns.o2[c] = o1;
+            ns.d1[c] = dv;
+            ns.o1[c] = i;
+          } else if (dv < d2) {
+            ns.d2[c] = dv;
+            ns.o2[c] = i;
+          }
+        }
+
+        if (ns.d1[c] != d1) {
+          main_heap.update(c);
+          diag.heap_updates++;
+        }
+
+        if (ns.o1[c] != o1) {
+          cells[o1].remove(c);
+          cells[ns.o1[c]].push(c);
+          diag.heap_updates++;
+        } else if (ns.d2[c] != d2) {
+          cells[o1].update(c);
+          diag.heap_updates++;
+        }
+      }
+    }
+    if (!same_selection(r, r_old) && diag.iterations >= max_iterations) {
+      diag.capped = true;
+      break;
+    }
+  } while (!same_selection(r, r_old));
+}
+
+// Swap points in and out of the selection `r` until no swap improves the
+// smallest distance from a replacement to the rest of the selection.
+//
+// For the pruned strategy, the distance from candidate c to its nearest
+// selected point s is bounded from above, for any pivot p, by
+// d(c, p) + d(p, s) via the triangle inequality. The transformed DIN99d
+// distance (a concave power of a Euclidean distance) is still a metric, so
+// min_p [d(c, p) + min_s d(p, s)] is a valid bound that only needs the few
+// pivot distances of c.
+//
+// Candidates that survive the bound are abandoned as soon as their running
+// minimum drops to the best value found so far, since they can then no
+// longer replace it (unless they win the tie, as in the scan). Each
+// candidate remembers which selected point was nearest to it the last time
+// it was evaluated and checks that one first: the selection only changes by
+// one point per swap, so it is usually still the nearest and the scan stops
+// after a single lookup.
+//
+// The local strategy starts from the observation that a point is held back
+// by the selected point nearest to it, and that the swaps that push it away
+// from there mostly move it to a nearby candidate. Its passes therefore
+// only weigh each point against its nearest candidates, at a cost of
+// n_neighbors instead of N evaluations per slot. Once a local pass moves
+// nothing, a full pruned pass over all candidates either finds a swap that
+// the neighbourhoods missed, after which the local passes resume, or
+// confirms that the selection has converged as in the other strategies.
+inline void swap_search(const double* dm,
+                        std::size_t N,
+                        std::vector<std::size_t>& r,
+                        const search_options& opts,
+                        search_diagnostics& diag) {
+  const std::size_t n = r.size();
+  const std::size_t n_fixed = opts.n_fixed;
+  const std::size_t max_iterations = opts.max_iterations;
+  const bool prune =
+    opts.strategy == swap_pruned || opts.strategy == swap_local;
+  const bool local = opts.strategy == swap_local && opts.neighbors &&
+    opts.n_neighbors > 0;
+  const std::size_t* tie_rank = opts.tie_rank;
+
+  QUALPAL_TRACE_SPAN("swap_search");
+  perf_phase phase("swap_search");
+  stats_timer timer(stats_search);
+
+  const search_deadline deadline(opts);
+
+  if (opts.strategy == swap_heap && n > 1) {
+    swap_search_heap(dm, N, r, n_fixed, max_iterations, opts.tie_rank,
+                     deadline, diag);
+    return;
+  }
+
+  scratch_vector<std::size_t> pivots;
+  scratch_vector<double> pivot_dist;
+  if (prune)
+    make_pivots(dm, N, opts.n_pivots, pivots, pivot_dist);
+  const std::size_t k = pivots.size();
+
+  scratch_vector<std::size_t> selected(N);
+  scratch_vector<std::size_t> incl;
+  scratch_vector<double> pivot_min(k);
+  scratch_vector<std::size_t> r_old;
+  scratch_vector<std::size_t> nearest_hint;
+
+  if (prune)
+    nearest_hint.assign(N, N);
+
+  // Counting (rather than flagging) the selected points keeps the multiset
+  // semantics of the original set difference if r contains duplicates
+  for (std::size_t j = 0; j < n; ++j)
+    selected[r[j]]++;
+
+  incl.reserve(n);
+  bool full = !local;
+
+  for (;;) {
+    QUALPAL_TRACE_SPAN(full ? "swap_pass" : "local_pass");
+
+    r_old.assign(r.begin(), r.end());
+    diag.iterations++;
+
+    for (std::size_t i = n_fixed; i < n; ++i) {
+      if (deadline.expired(diag))
+        return;
+
+      // Put r[i] back among the candidates; what remains is the selection
+      // that a replacement has to be distant from
+      const std::size_t u = r[i];
+      selected[u]--;
+
+      incl.clear();
+      for (std::size_t j = 0; j < n; ++j)
+        if (j != i)
+          incl.push_back(r[j]);
+
+      const bool bound = prune && full;
+      if (bound) {
+        for (std::size_t p = 0; p < k; ++p) {
+          double m = std::numeric_limits<double>::infinity();
+          for (std::size_t s = 0; s < incl.size(); ++s)
+            m = std::min(m, dist_at(dm, N, pivots[p], incl[s]));
+          pivot_min[p] = m;
+        }
+      }
+
+      double best = -std::numeric_limits<double>::infinity();
+      std::size_t best_c = u;
+
+      auto consider = [&](std::size_t c) {
+        if (selected[c])
+          return;
+
+        diag.candidates++;
+
+        if (bound) {
+          const double* pd = &pivot_dist[c*k];
+          double ub = std::numeric_limits<double>::infinity();
+          for (std::size_t p = 0; p < k; ++p)
+            ub = std::min(ub, pd[p] + pivot_min[p]);
+
+          // Leave some slack for rounding in the triangle inequality so that
+          // the pruning stays exact; a tie could still win by rank.
+          if (ub*(1 + 1e-12) < best) {
+            diag.pruned++;
+            return;
+          }
+        }
+
+        const double* col = dm + c*N;
+        double d = std::numeric_limits<double>::infinity();
+
+        if (prune) {
+          std::size_t hint = nearest_hint[c];
+          if (hint < N && selected[hint])
+            d = col[hint];
+
+          // Ties with the best candidate only matter if c wins them
+          const bool wins_tie = tie_before(tie_rank, c, best_c);
+
+          std::size_t s = 0;
+          for (; s < incl.size() && (d > best || (d == best && wins_tie));
+               ++s) {
+            if (col[incl[s]] < d) {
+              d = col[incl[s]];
+              hint = incl[s];
+            }
+          }
+
+          nearest_hint[c] = hint;
+
+          if (d < best || (d == best && !wins_tie)) {
+            if (s < incl.size())
+              diag.abandoned++;
+            return;
+          }
+        } else {
+          for (std::size_t s = 0; s < incl.size(); ++s)
+            d = std::min(d, col[incl[s]]);
+        }
+
+        if (d > best || (d == best && tie_before(tie_rank, c, best_c))) {
+          best = d;
+          best_c = c;
+        }
+      };
+
+      if (full) {
+        for (std::size_t c = 0; c < N; ++c)
+          consider(c);
+      } else {
+        consider(u);
+        const std::size_t* nb = opts.neighbors + u*opts.n_neighbors;
+        for (std::size_t j = 0; j < opts.n_neighbors; ++j)
+          consider(nb[j]);
+      }
+
+      r[i] = best_c;
+      selected[best_c]++;
+    }
+
+    const bool changed = !same_selection(r, r_old);
+    if (changed && diag.iterations >= max_iterations) {
+      diag.capped = true;
+      break;
+    }
+    if (!changed && full)
+      break;
+
+    // Local passes go on while they move points
+    full = !local || !changed;
+  }
+}
+
+// Arrange the selected points in the order of how distinct they are from
+// one another: start with the two most distant points and then repeatedly
+// add the point farthest from those already picked.
+inline std::vector<std::size_t> order_selection(const double* dm,
+                                                std::size_t N,
+                                                const std::vector<std::size_t>& r) {
+  const std::size_t n = r.size();
+  scratch_vector<std::size_t> sorted;
+
+  QUALPAL_TRACE_SPAN("order_selection");
+  perf_phase phase("ordering");
+  stats_timer timer(stats_ordering);
+
+  if (n < 2)
+    return r;
+
+  // The first maximum in column-major order of the (symmetric) submatrix
+  double best = -std::numeric_limits<double>::infinity();
+  std::size_t best_row = 0, best_col = 0;
+  for (std::size_t b = 0; b < n; ++b) {
+    for (std::size_t a = 0; a < n; ++a) {
+      double d = dist_at(dm, N, r[a], r[b]);
+      if (d > best) {
+        best = d;
+        best_row = a;
+        best_col = b;
+      }
+    }
+  }
+
+  sorted.push_back(best_row);
+  sorted.push_back(best_col);
+
+  scratch_vector<char> picked(n);
+  picked[best_row] = picked[best_col] = 1;
+
+  while (sorted.size() < n) {
+    double best_min = -std::numeric_limits<double>::infinity();
+    std::size_t next = 0;
+    for (std::size_t a = 0; a < n; ++a) {
+      if (picked[a])
+        continue;
+      double d = std::numeric_limits<double>::infinity();
+      for (std::size_t s = 0; s < sorted.size(); ++s)
+        d = std::min(d, dist_at(dm, N, r[sorted[s]], r[a]));
+      if (d > best_min) {
+        best_min = d;
+        next = a;
+      }
+    }
+    picked[next] = 1;
+    sorted.push_back(next);
+  }
+
+  std::vector<std::size_t> out(n);
+  for (std::size_t a = 0; a < n; ++a)
+    out[a] = r[sorted[a]];
+
+  return out;
+}
+
+// Scratch memory (in bytes) that a search for n of N points will take from
+// the arena, so that it can be reserved in one go
+inline std::size_t search_scratch_bytes(std::size_t N,
+                                        std::size_t n,
+                                        const search_options& opts) {
+  const std::size_t w = sizeof(std::size_t), d = sizeof(double);
+  std::size_t bytes = 2*n*w + n;  // r_old, ordering
+
+  if (opts.strategy == swap_heap) {
+    // nearest and second-nearest points, counts, heap positions and items,
+    // the traversal stacks (with slack for growth), and the cell heaps
+    bytes += N*(2*d + 2*w) + N*w + 2*N*w + 3*N*w + 2*N*w +
+      n*sizeof(indexed_heap);
+  } else {
+    const std::size_t k = std::min(opts.n_pivots, N);
+    bytes += 2*N*w + n*w;
+    if (opts.strategy == swap_pruned || opts.strategy == swap_local)
+      bytes += k*w + N*k*d + N*d + k*d + N*w;
+  }
+
+  // Alignment padding for each buffer
+  return bytes + 64*(n + 16);
+}
+
+// Select n points that are maximally distinct from one another and return
+// their (0-based) indices, ordered by distinctness.
+inline std::vector<std::size_t> farthest_points(const double* dm,
+                                                std::size_t N,
+                                                std::size_t n,
+                                                const search_options& opts,
+                                                search_diagnostics& diag) {
+  std::vector<std::size_t> r = initial_selection(N, n);
+  swap_search(dm, N, r, opts, diag);
+  return order_selection(dm, N, r);
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_FARTHEST_POINTS_H
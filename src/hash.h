@@ -0,0 +1,36 @@
+// A stable, platform-independent hash (64-bit FNV-1a) for keying cached
+// candidate sets and results, which must hash the same across sessions and
+// machines.
+
+#ifndef QUALPALR_HASH_H
+#define QUALPALR_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace qualpal {
+
+inline std::uint64_t fnv1a(const void* data,
+                           std::size_t bytes,
+                           std::uint64_t h = 14695981039346656037ULL) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < bytes; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// 16 lowercase hex digits
+inline std::string hash_hex(std::uint64_t h) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out(16, '0');
+  for (int i = 15; i >= 0; --i, h >>= 4)
+    out[i] = digits[h & 0xf];
+  return out;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_HASH_H
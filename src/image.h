@@ -0,0 +1,254 @@
+// Streaming reader for the colors of binary PPM (P6) and PAM (P7) images
+// and of raw interleaved 8-bit RGB data.
+//
+// Pixels are read in chunks and only colors that have not been seen before
+// are handed on, so a sink such as a grid_coreset converts every distinct
+// color once, however large the image. Colors count as seen at 8 bits per
+// channel (a bitmap of 2^24 bits), and 16-bit images pass on the first
+// color of every such 8-bit cell at full precision. Memory stays at the
+// bitmap, one chunk of pixels, and whatever the sink keeps. Gray images are
+// read as gray colors, and fully transparent pixels of images with an alpha
+// channel are skipped.
+
+#ifndef QUALPALR_IMAGE_H
+#define QUALPALR_IMAGE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace qualpal {
+
+enum image_format { image_auto, image_ppm, image_pam, image_raw };
+
+inline bool parse_image_format(const std::string& name, image_format& out) {
+  if (name == "auto")
+    out = image_auto;
+  else if (name == "ppm")
+    out = image_ppm;
+  else if (name == "pam")
+    out = image_pam;
+  else if (name == "raw")
+    out = image_raw;
+  else
+    return false;
+  return true;
+}
+
+struct image_info {
+  image_format format;
+  std::size_t width, height;  // 0 for raw data
+  unsigned depth;             // channels per pixel
+  unsigned maxval;
+  std::size_t pixels;         // pixels read
+  std::size_t transparent;    // pixels skipped for being fully transparent
+  std::size_t distinct;       // distinct colors at 8 bits per channel
+
+  image_info()
+    : format(image_raw), width(0), height(0), depth(3), maxval(255),
+      pixels(0), transparent(0), distinct(0) {}
+};
+
+namespace detail {
+
+// The next whitespace-separated token of a PPM header, skipping comments;
+// the single whitespace character after the token is consumed too
+inline std::string ppm_token(std::istream& in) {
+  std::string out;
+  int c = in.get();
+  for (;;) {
+    if (c == '#') {
+      while (c != EOF && c != '\n')
+        c = in.get();
+    } else if (c != EOF && std::isspace(c)) {
+      c = in.get();
+    } else {
+      break;
+    }
+  }
+  while (c != EOF && !std::isspace(c) && c != '#') {
+    out += static_cast<char>(c);
+    c = in.get();
+  }
+  if (c == '#')
+    in.unget();
+  return out;
+}
+
+inline std::size_t header_number(const std::string& token, const char* what) {
+  char* end = 0;
+  const unsigned long x = std::strtoul(token.c_str(), &end, 10);
+  if (token.empty() || *end != '\0' || x == 0)
+    throw std::runtime_error(std::string("invalid ") + what +
+                             " in image header");
+  return x;
+}
+
+inline void read_ppm_header(std::istream& in, image_info& info) {
+  info.width = header_number(ppm_token(in), "width");
+  info.height = header_number(ppm_token(in), "height");
+  info.maxval = header_number(ppm_token(in), "maximum value");
+  info.depth = 3;
+}
+
+inline void read_pam_header(std::istream& in, image_info& info) {
+  info.width = info.height = info.depth = info.maxval = 0;
+  std::string line;
+  for (;;) {
+    if (!std::getline(in, line))
+      throw std::runtime_error("unterminated PAM header");
+    const std::size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+
+    std::size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+      continue;
+    std::size_t end = line.find_first_of(" \t\r", begin);
+    const std::string key = line.substr(begin, end - begin);
+    if (key == "ENDHDR")
+      break;
+
+    begin = end == std::string::npos ? end :
+      line.find_first_not_of(" \t\r", end);
+    const std::string value = begin == std::string::npos ? "" :
+      line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin);
+
+    if (key == "WIDTH")
+      info.width = header_number(value, "width");
+    else if (key == "HEIGHT")
+      info.height = header_number(value, "height");
+    else if (key == "DEPTH")
+      info.depth = header_number(value, "depth");
+    else if (key == "MAXVAL")
+      info.maxval = header_number(value, "maximum value");
+  }
+
+  if (info.width == 0 || info.height == 0 || info.depth == 0 ||
+      info.maxval == 0)
+    throw std::runtime_error("incomplete PAM header");
+  if (info.depth > 4)
+    throw std::runtime_error("PAM images must have 1 to 4 channels");
+}
+
+} // namespace detail
+
+// Read the colors of an image from `in` (opened in binary mode), calling
+// add(rgb) with sRGB components in [0, 1] for every new color. Throws
+// std::runtime_error on malformed or truncated input.
+template <typename Sink>
+inline image_info read_image(std::istream& in,
+                             image_format format,
+                             Sink add,
+                             std::size_t chunk_pixels = 65536) {
+  image_info info;
+
+  // Bytes consumed while detecting the format that turned out to be pixels
+  std::string prefix;
+
+  if (format != image_raw) {
+    char magic[2] = {0, 0};
+    in.read(magic, 2);
+    prefix.assign(magic, static_cast<std::size_t>(in.gcount()));
+
+    if (prefix == "P6")
+      format = image_ppm;
+    else if (prefix == "P7")
+      format = image_pam;
+    else if (format != image_auto)
+      throw std::runtime_error(format == image_ppm ?
+                               "not a binary PPM (P6) image" :
+                               "not a PAM (P7) image");
+    else
+      format = image_raw;
+  }
+
+  info.format = format;
+  if (format == image_ppm) {
+    detail::read_ppm_header(in, info);
+    prefix.clear();
+  } else if (format == image_pam) {
+    detail::read_pam_header(in, info);
+    prefix.clear();
+  }
+
+  if (info.maxval > 65535)
+    throw std::runtime_error("maximum values above 65535 are not supported");
+
+  const std::size_t sample_bytes = info.maxval > 255 ? 2 : 1;
+  const std::size_t pixel_bytes = info.depth*sample_bytes;
+  const bool alpha = info.depth == 2 || info.depth == 4;
+  const bool gray = info.depth < 3;
+  const std::size_t expected = info.width*info.height;
+  const double maxval = info.maxval;
+
+  std::vector<bool> seen(std::size_t(1) << 24, false);
+  std::vector<char> buffer(chunk_pixels*pixel_bytes);
+  std::size_t filled = prefix.copy(buffer.data(), prefix.size());
+
+  for (;;) {
+    std::size_t want = buffer.size();
+    if (expected > 0)
+      want = std::min(want, (expected - info.pixels)*pixel_bytes);
+    if (want == 0)
+      break;
+
+    if (filled < want) {
+      in.read(buffer.data() + filled, want - filled);
+      filled += static_cast<std::size_t>(in.gcount());
+    }
+    const std::size_t got = filled;
+    filled = 0;
+
+    const std::size_t n_pixels = got/pixel_bytes;
+    const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(buffer.data());
+
+    for (std::size_t i = 0; i < n_pixels; ++i, p += pixel_bytes) {
+      unsigned v[4] = {0, 0, 0, 0};
+      for (unsigned k = 0; k < info.depth; ++k) {
+        v[k] = sample_bytes == 2 ? (p[2*k] << 8) | p[2*k + 1] : p[k];
+        if (v[k] > info.maxval)
+          throw std::runtime_error("sample exceeds maximum value");
+      }
+
+      if (alpha && v[info.depth - 1] == 0) {
+        info.transparent++;
+        continue;
+      }
+
+      const unsigned c[3] = {v[0], gray ? v[0] : v[1], gray ? v[0] : v[2]};
+      std::size_t key = 0;
+      for (int k = 0; k < 3; ++k)
+        key = (key << 8) | (c[k]*255 + info.maxval/2)/info.maxval;
+      if (seen[key])
+        continue;
+      seen[key] = true;
+      info.distinct++;
+
+      const double rgb[3] = {c[0]/maxval, c[1]/maxval, c[2]/maxval};
+      add(rgb);
+    }
+    info.pixels += n_pixels;
+
+    // The end of the input
+    if (got < want) {
+      if (expected > 0)
+        throw std::runtime_error("truncated image data");
+      if (got % pixel_bytes != 0)
+        throw std::runtime_error("raw data must consist of 8-bit RGB triplets");
+      break;
+    }
+  }
+
+  return info;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_IMAGE_H
@@ -0,0 +1,195 @@
+// The k nearest neighbours of every candidate color, for the local swap
+// search (swap_local in farthest_points.h).
+//
+// The candidates are indexed by a k-d tree in DIN99d space that halves the
+// widest extent of each node at its median, down to small leaves. Every
+// candidate then queries the tree for its neighbours, visiting the nearer
+// child first and skipping children on the far side of a split that is
+// farther away than the k-th neighbour found so far. The queries are
+// independent and run in parallel. Neighbours are found by squared
+// Euclidean distance in DIN99d space, with ties going to the lower index.
+// Both differences of distance_metric grow with that distance, so they have
+// the same neighbours. CIEDE2000 does not, and the local strategy is only
+// used with distance_metric (see select_colors() in R/qualpal.R).
+
+#ifndef QUALPALR_KNN_GRAPH_H
+#define QUALPALR_KNN_GRAPH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct knn_graph {
+  std::size_t k;
+  std::vector<std::size_t> neighbors;  // k per candidate, nearest first
+
+  knn_graph() : k(0) {}
+
+  bool empty() const { return neighbors.empty(); }
+};
+
+class kd_tree {
+public:
+  kd_tree(const double* x, std::size_t N, std::size_t leaf_size = 8)
+    : x(x), items(N) {
+    for (std::size_t i = 0; i < N; ++i)
+      items[i] = i;
+    if (N > 0)
+      build(0, N, std::max<std::size_t>(leaf_size, 1));
+  }
+
+  // The k points nearest to point q, other than q itself, nearest first
+  void nearest(std::size_t q, std::size_t k, std::size_t* out) const {
+    std::vector<std::pair<double, std::size_t> > heap;
+    heap.reserve(k + 1);
+    if (k > 0 && !nodes.empty())
+      visit(0, q, k, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    for (std::size_t j = 0; j < heap.size(); ++j)
+      out[j] = heap[j].second;
+  }
+
+private:
+  struct node {
+    std::size_t begin, end;  // the points of the subtree in `items`
+    int axis;                // -1 for leaves
+    double split;
+    std::size_t left, right;
+  };
+
+  double dist2(std::size_t a, std::size_t b) const {
+    double out = 0;
+    for (int k = 0; k < 3; ++k) {
+      const double d = x[3*a + k] - x[3*b + k];
+      out += d*d;
+    }
+    return out;
+  }
+
+  std::size_t build(std::size_t begin, std::size_t end, std::size_t leaf_size) {
+    const std::size_t k = nodes.size();
+    node nd = {begin, end, -1, 0, 0, 0};
+    nodes.push_back(nd);
+    if (end - begin <= leaf_size)
+      return k;
+
+    double lo[3], hi[3];
+    for (int a = 0; a < 3; ++a)
+      lo[a] = hi[a] = x[3*items[begin] + a];
+    for (std::size_t i = begin + 1; i < end; ++i) {
+      for (int a = 0; a < 3; ++a) {
+        lo[a] = std::min(lo[a], x[3*items[i] + a]);
+        hi[a] = std::max(hi[a], x[3*items[i] + a]);
+      }
+    }
+
+    int axis = 0;
+    for (int a = 1; a < 3; ++a)
+      if (hi[a] - lo[a] > hi[axis] - lo[axis])
+        axis = a;
+
+    const double* px = x;
+    const std::size_t mid = begin + (end - begin)/2;
+    std::nth_element(items.begin() + begin, items.begin() + mid,
+                     items.begin() + end,
+                     [px, axis](std::size_t a, std::size_t b) {
+                       const double xa = px[3*a + axis], xb = px[3*b + axis];
+                       return xa < xb || (xa == xb && a < b);
+                     });
+
+    const double split = x[3*items[mid] + axis];
+    const std::size_t left = build(begin, mid, leaf_size);
+    const std::size_t right = build(mid, end, leaf_size);
+
+    node& out = nodes[k];
+    out.axis = axis;
+    out.split = split;
+    out.left = left;
+    out.right = right;
+    return k;
+  }
+
+  // Keep the k best (distance, index) pairs in a max-heap
+  void visit(std::size_t k_node,
+             std::size_t q,
+             std::size_t k,
+             std::vector<std::pair<double, std::size_t> >& heap) const {
+    const node& nd = nodes[k_node];
+
+    if (nd.axis < 0) {
+      for (std::size_t i = nd.begin; i < nd.end; ++i) {
+        const std::size_t c = items[i];
+        if (c == q)
+          continue;
+        const std::pair<double, std::size_t> item(dist2(q, c), c);
+        if (heap.size() < k) {
+          heap.push_back(item);
+          std::push_heap(heap.begin(), heap.end());
+        } else if (item < heap.front()) {
+          std::pop_heap(heap.begin(), heap.end());
+          heap.back() = item;
+          std::push_heap(heap.begin(), heap.end());
+        }
+      }
+      return;
+    }
+
+    const double diff = x[3*q + nd.axis] - nd.split;
+    const std::size_t near = diff < 0 ? nd.left : nd.right;
+    const std::size_t far = diff < 0 ? nd.right : nd.left;
+
+    visit(near, q, k, heap);
+    if (heap.size() < k || diff*diff <= heap.front().first)
+      visit(far, q, k, heap);
+  }
+
+  const double* x;
+  std::vector<std::size_t> items;
+  std::vector<node> nodes;
+};
+
+// The k nearest neighbours of each of the N colors with row-major DIN99d
+// coordinates x, querying by calling run_parallel(N, f), which must call
+// f(begin, end) for ranges of candidates covering [0, N)
+template <typename ParallelFor>
+inline knn_graph make_knn_graph(const double* x,
+                                std::size_t N,
+                                std::size_t k,
+                                ParallelFor run_parallel) {
+  QUALPAL_TRACE_SPAN("knn_graph");
+
+  knn_graph out;
+  out.k = N > 1 ? std::min(k, N - 1) : 0;
+  out.neighbors.resize(N*out.k);
+  if (out.k == 0)
+    return out;
+
+  const kd_tree tree(x, N);
+  run_parallel(N, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t c = begin; c < end; ++c)
+      tree.nearest(c, out.k, &out.neighbors[c*out.k]);
+  });
+
+  return out;
+}
+
+// The graph on a thread pool (or on the calling thread if null)
+inline knn_graph make_knn_graph(const double* x,
+                                std::size_t N,
+                                std::size_t k,
+                                thread_pool* pool = 0) {
+  const pool_loop loop = {pool, 256};
+  return make_knn_graph(x, N, k, loop);
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_KNN_GRAPH_H
@@ -0,0 +1,115 @@
+// Reordering of candidates along a Morton (Z-order) curve in DIN99d space.
+//
+// Candidates arrive in whatever order the torus sampler or the caller gave
+// them, which is spatially random. Sorting them by their position on a
+// space-filling curve puts colors that are close to one another next to
+// each other in memory, so that the columns of the distance matrix that a
+// search reads one after the other, and the rows that it looks up in them,
+// are more often already in cache.
+//
+// The reordering is internal: a candidate_order maps between the original
+// indices and the positions in the reordered set, and the search breaks
+// ties by original index (see search_options::tie_rank), so that callers
+// get the same palette, with the same indices, as without it.
+
+#ifndef QUALPALR_LOCALITY_H
+#define QUALPALR_LOCALITY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace qualpal {
+
+// Spread the lower 21 bits of x out to every third bit
+inline std::uint64_t morton_spread(std::uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+// The Morton code of a point whose coordinates have been scaled to
+// [0, 2^21)
+inline std::uint64_t morton_code(const std::uint64_t* q) {
+  return morton_spread(q[0]) | morton_spread(q[1]) << 1 |
+    morton_spread(q[2]) << 2;
+}
+
+struct candidate_order {
+  std::vector<std::size_t> order;  // original index of each position
+  std::vector<std::size_t> rank;   // position of each original index
+
+  std::size_t size() const { return order.size(); }
+
+  // Append candidates that keep their place at the end
+  void extend(std::size_t n) {
+    for (std::size_t k = 0; k < n; ++k) {
+      order.push_back(order.size());
+      rank.push_back(rank.size());
+    }
+  }
+};
+
+// The order of the row-major coordinates x along a Morton curve through
+// their bounding cube. Points in the same cell of the curve keep their
+// original order.
+inline candidate_order morton_order(const std::vector<double>& x) {
+  const std::size_t N = x.size()/3;
+  candidate_order out;
+  if (N == 0)
+    return out;
+
+  double lo[3], hi[3];
+  for (int k = 0; k < 3; ++k)
+    lo[k] = hi[k] = x[k];
+  for (std::size_t i = 1; i < N; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::min(lo[k], x[3*i + k]);
+      hi[k] = std::max(hi[k], x[3*i + k]);
+    }
+  }
+
+  // One scale for all axes, so that cells are cubes
+  double extent = 0;
+  for (int k = 0; k < 3; ++k)
+    extent = std::max(extent, hi[k] - lo[k]);
+  const double max_cell = double((1 << 21) - 1);
+  const double scale = extent > 0 ? max_cell/extent : 0;
+
+  std::vector<std::pair<std::uint64_t, std::size_t> > keys(N);
+  for (std::size_t i = 0; i < N; ++i) {
+    std::uint64_t q[3];
+    for (int k = 0; k < 3; ++k)
+      q[k] = static_cast<std::uint64_t>((x[3*i + k] - lo[k])*scale);
+    keys[i] = std::make_pair(morton_code(q), i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  out.order.resize(N);
+  out.rank.resize(N);
+  for (std::size_t k = 0; k < N; ++k) {
+    out.order[k] = keys[k].second;
+    out.rank[keys[k].second] = k;
+  }
+
+  return out;
+}
+
+// Rows of the row-major, three-column matrix x in the given order
+inline std::vector<double> permute_rows(const std::vector<double>& x,
+                                        const std::vector<std::size_t>& order) {
+  std::vector<double> out(3*order.size());
+  for (std::size_t k = 0; k < order.size(); ++k)
+    std::copy(&x[3*order[k]], &x[3*order[k]] + 3, &out[3*k]);
+  return out;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_LOCALITY_H
@@ -0,0 +1,202 @@
+// The largest palette whose colors are all at least `target` apart.
+//
+// Instead of running a separate search for every n, the candidates are
+// traversed once farthest-first (Gonzalez's algorithm): the i-th point of
+// the traversal is at distance radius[i] from the points before it, and
+// every candidate is within radius[i] of one of them. Any i + 1 candidates
+// therefore include two within 2*radius[i] of each other, which bounds n
+// from above. From below, the greedy set of traversal points that are at
+// least `target` from each other is already a valid palette.
+//
+// Between the bounds, n grows one color at a time: each palette starts from
+// the previous one plus the candidate farthest from it, and is searched
+// only if that start does not already reach the target. The first n at
+// which the search falls short ends the query. Since a swap never brings
+// the selection closer together, searching the final palette cannot make it
+// fall below the target either.
+
+#ifndef QUALPALR_MAX_N_H
+#define QUALPALR_MAX_N_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "farthest_points.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct max_n_result {
+  std::vector<std::size_t> indices;  // the palette, ordered by distinctness
+  double min_de;                     // empty palette: 0
+  std::size_t lower, upper;          // bounds on n before searching
+  std::size_t searches;
+  search_diagnostics diagnostics;
+
+  max_n_result() : min_de(0), lower(0), upper(0), searches(0) {}
+};
+
+// The smallest distance between the selected points
+inline double selection_min(const double* dm,
+                            std::size_t N,
+                            const std::vector<std::size_t>& r) {
+  double out = std::numeric_limits<double>::infinity();
+  for (std::size_t a = 0; a < r.size(); ++a)
+    for (std::size_t b = 0; b < a; ++b)
+      out = std::min(out, dist_at(dm, N, r[a], r[b]));
+  return out;
+}
+
+// Lower the distance of every candidate to the selection by that to c
+inline void add_to_nearest(const double* dm,
+                           std::size_t N,
+                           std::size_t c,
+                           std::vector<double>& nearest) {
+  const double* col = dm + c*N;
+  for (std::size_t i = 0; i < N; ++i)
+    nearest[i] = std::min(nearest[i], col[i]);
+}
+
+inline void nearest_to_selection(const double* dm,
+                                 std::size_t N,
+                                 const std::vector<std::size_t>& r,
+                                 std::vector<double>& nearest) {
+  nearest.assign(N, std::numeric_limits<double>::infinity());
+  for (std::size_t j = 0; j < r.size(); ++j)
+    add_to_nearest(dm, N, r[j], nearest);
+}
+
+// The farthest-first traversal of all candidates, starting from the one
+// farthest from candidate 0, and the distance of every point to those
+// before it (infinite for the first)
+inline void farthest_first(const double* dm,
+                           std::size_t N,
+                           std::vector<std::size_t>& order,
+                           std::vector<double>& radius) {
+  order.clear();
+  radius.clear();
+  if (N == 0)
+    return;
+
+  const double* col = dm;
+  std::size_t next = std::max_element(col, col + N) - col;
+
+  std::vector<double> nearest(N, std::numeric_limits<double>::infinity());
+  std::vector<char> taken(N);
+  double r = std::numeric_limits<double>::infinity();
+
+  for (std::size_t k = 0; k < N; ++k) {
+    order.push_back(next);
+    radius.push_back(r);
+    taken[next] = 1;
+
+    col = dm + next*N;
+    r = -1;
+    for (std::size_t c = 0; c < N; ++c) {
+      nearest[c] = std::min(nearest[c], col[c]);
+      if (!taken[c] && nearest[c] > r) {
+        r = nearest[c];
+        next = c;
+      }
+    }
+  }
+}
+
+// The largest palette of at most n_max colors (but at least two) whose
+// smallest color difference is at least `target`; empty if not even two
+// candidates are that far apart
+inline max_n_result max_n_points(const double* dm,
+                                 std::size_t N,
+                                 double target,
+                                 std::size_t n_max,
+                                 search_options opts = search_options()) {
+  QUALPAL_TRACE_SPAN("max_n_points");
+
+  max_n_result out;
+  n_max = std::min(n_max, N);
+
+  std::vector<std::size_t> order;
+  std::vector<double> radius;
+  farthest_first(dm, N, order, radius);
+
+  // No n + 1 candidates are all more than 2*radius[n] apart (with some slack
+  // for rounding in the triangle inequality)
+  std::size_t upper = 1;
+  while (upper < n_max && 2*radius[upper]*(1 + 1e-12) >= target)
+    upper++;
+
+  // Greedily take the traversal points that keep their distance
+  std::vector<std::size_t> r;
+  std::vector<double> nearest(N, std::numeric_limits<double>::infinity());
+  for (std::size_t k = 0; k < N && r.size() < upper; ++k) {
+    const std::size_t c = order[k];
+    if (nearest[c] < target)
+      continue;
+    r.push_back(c);
+    add_to_nearest(dm, N, c, nearest);
+  }
+
+  // The traversal does not start at the two most distant candidates, which
+  // may be the only pair that reaches the target
+  if (r.size() < 2 && upper > 1) {
+    const std::size_t k = std::max_element(dm, dm + N*N) - dm;
+    if (dm[k] >= target) {
+      r.assign(1, k % N);
+      r.push_back(k/N);
+      nearest_to_selection(dm, N, r, nearest);
+    }
+  }
+
+  out.lower = r.size() > 1 ? r.size() : 0;
+  out.upper = upper > 1 ? upper : 0;
+  if (out.upper == 0)
+    return out;
+
+  std::vector<std::size_t> best;
+  if (out.lower > 0)
+    best = r;
+
+  for (std::size_t n = r.size() + 1; n <= upper; ++n) {
+    // Start from the previous palette and the candidate farthest from it
+    const std::size_t farthest =
+      std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+    r.push_back(farthest);
+
+    bool feasible = selection_min(dm, N, r) >= target;
+    if (!feasible) {
+      search_diagnostics diag;
+      swap_search(dm, N, r, opts, diag);
+      out.searches++;
+      accumulate(out.diagnostics, diag);
+      feasible = selection_min(dm, N, r) >= target;
+    }
+    if (!feasible)
+      break;
+
+    best = r;
+    nearest_to_selection(dm, N, r, nearest);
+  }
+
+  if (best.empty())
+    return out;
+
+  // Spread out the palette, which may have been accepted without a search
+  search_diagnostics diag;
+  swap_search(dm, N, best, opts, diag);
+  out.searches++;
+  accumulate(out.diagnostics, diag);
+
+  out.indices = order_selection(dm, N, best);
+  out.min_de = selection_min(dm, N, out.indices);
+  stats_add(stats_calls_global);
+  stats_add_outcome(out.diagnostics);
+
+  return out;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_MAX_N_H
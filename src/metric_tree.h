@@ -0,0 +1,358 @@
+// Farthest points under an arbitrary color difference, without a distance
+// matrix.
+//
+// The k-d tree of divide_conquer.h and the pivot bounds of the pruned scan
+// rely on DIN99d coordinates and the triangle inequality. Other color
+// differences need not have either, so this search works through a metric
+// policy: any object with operator()(a, b) giving the difference between
+// candidates a and b, and is_metric(), which tells whether the difference
+// satisfies the triangle inequality.
+//
+// For metrics, the candidates are indexed by a vantage-point tree: every
+// node splits its points by their distance to a vantage point at the
+// median, and remembers how far the farthest point on either side is. The
+// swap search asks the tree for the candidate farthest from the rest of the
+// selection. For a node with vantage point v, no candidate in a subtree
+// whose points are at most `hi` from v can be farther than hi + d(v, s)
+// from a selected point s, so subtrees whose bound cannot beat the best
+// candidate found so far are skipped, and the rest are visited in the order
+// of their bounds. CIEDE2000 is not a metric and no bound on its violations
+// is known, so for it every candidate is evaluated, as in the scan over the
+// full distance matrix, though with early abandoning.
+//
+// Either way, the differences between candidates and selected colors are
+// cached per slot of the selection, so memory is linear in the number of
+// candidates, and the search selects the same colors as the brute-force
+// scan on the full distance matrix.
+
+#ifndef QUALPALR_METRIC_TREE_H
+#define QUALPALR_METRIC_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "color_conversion.h"
+#include "distance.h"
+#include "farthest_points.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace qualpal {
+
+// Color differences between row-major DIN99d coordinates
+struct coordinate_metric {
+  const double* x;
+  distance_metric metric;
+
+  double operator()(std::size_t a, std::size_t b) const {
+    return color_distance(metric, x + 3*a, x + 3*b);
+  }
+
+  bool is_metric() const { return true; }
+};
+
+// CIEDE2000 differences between colors given by their DIN99d coordinates
+class ciede2000_metric {
+public:
+  explicit ciede2000_metric(const std::vector<double>& din99d)
+    : lab(din99d.size()) {
+    for (std::size_t i = 0; i < din99d.size()/3; ++i) {
+      double xyz[3];
+      din99d_xyz(&din99d[3*i], xyz);
+      xyz_lab(xyz, &lab[3*i]);
+    }
+  }
+
+  // The formula is not exactly symmetric in floating point, so always
+  // evaluate it in the same order
+  double operator()(std::size_t a, std::size_t b) const {
+    if (a > b)
+      std::swap(a, b);
+    return ciede2000_distance(&lab[3*a], &lab[3*b]);
+  }
+
+  bool is_metric() const { return false; }
+
+private:
+  std::vector<double> lab;
+};
+
+// Distances from every candidate to the points held by the slots of a
+// selection, computed on first use and kept until the slot changes. A swap
+// pass thus evaluates at most N differences per changed slot.
+template <typename Metric>
+class selection_distances {
+public:
+  selection_distances(const Metric& d, std::size_t N, std::size_t n)
+    : d(d), n(n), point(n), version(n, 1), stamp(N*n, 0), cached(N*n) {}
+
+  void set(std::size_t slot, std::size_t p) {
+    point[slot] = p;
+    version[slot]++;
+  }
+
+  double operator()(std::size_t c, std::size_t slot) {
+    const std::size_t k = c*n + slot;
+    if (stamp[k] != version[slot]) {
+      cached[k] = d(c, point[slot]);
+      stamp[k] = version[slot];
+    }
+    return cached[k];
+  }
+
+private:
+  const Metric& d;
+  const std::size_t n;
+  std::vector<std::size_t> point, version, stamp;
+  std::vector<double> cached;
+};
+
+template <typename Metric>
+class vp_tree {
+public:
+  vp_tree(const Metric& d, std::size_t N, std::size_t leaf_size = 8)
+    : d(d), items(N) {
+    for (std::size_t i = 0; i < N; ++i)
+      items[i] = i;
+    if (N > 0 && d.is_metric())
+      build(0, N, std::max<std::size_t>(leaf_size, 1));
+  }
+
+  std::size_t size() const { return items.size(); }
+
+  // The candidate whose nearest point among the slots `from` of the
+  // selection is the farthest away, of those for which skip(c) is false;
+  // ties go to the lower index. Returns `best` unchanged if no candidate
+  // beats it (with distance best_d, which is updated otherwise).
+  template <typename Skip>
+  std::size_t farthest_from(selection_distances<Metric>& dist,
+                            const std::vector<std::size_t>& from,
+                            const Skip& skip,
+                            std::size_t best,
+                            double& best_d,
+                            search_diagnostics& diag) const {
+    if (!nodes.empty())
+      visit(0, dist, from, skip, best, best_d, diag);
+    else  // no tree without the triangle inequality
+      for (std::size_t c = 0; c < items.size(); ++c)
+        consider(c, dist, from, skip, best, best_d, diag);
+    return best;
+  }
+
+private:
+  static std::size_t none() { return std::size_t(-1); }
+
+  struct node {
+    std::size_t vp;               // none() for leaves
+    std::size_t begin, end;       // the points of the subtree in `items`
+    std::size_t inside, outside;  // children, or none()
+    double inside_hi, outside_hi; // farthest point of each child from vp
+  };
+
+  std::size_t build(std::size_t begin, std::size_t end, std::size_t leaf_size) {
+    const std::size_t k = nodes.size();
+    node nd = {none(), begin, end, none(), none(), 0, 0};
+    nodes.push_back(nd);
+    if (end - begin <= leaf_size)
+      return k;
+
+    // The first point is the vantage point; split the rest at the median
+    // distance from it
+    const std::size_t vp = items[begin];
+    std::vector<std::pair<double, std::size_t> > by_distance;
+    by_distance.reserve(end - begin - 1);
+    for (std::size_t i = begin + 1; i < end; ++i)
+      by_distance.push_back(std::make_pair(d(vp, items[i]), items[i]));
+
+    const std::size_t half = by_distance.size()/2;
+    std::nth_element(by_distance.begin(), by_distance.begin() + half,
+                     by_distance.end());
+
+    double inside_hi = 0, outside_hi = 0;
+    for (std::size_t i = 0; i < by_distance.size(); ++i) {
+      items[begin + 1 + i] = by_distance[i].second;
+      double& hi = i < half ? inside_hi : outside_hi;
+      hi = std::max(hi, by_distance[i].first);
+    }
+    by_distance.clear();
+
+    const std::size_t mid = begin + 1 + half;
+    const std::size_t inside = mid > begin + 1 ?
+      build(begin + 1, mid, leaf_size) : none();
+    const std::size_t outside = end > mid ? build(mid, end, leaf_size) : none();
+
+    node& out = nodes[k];
+    out.vp = vp;
+    out.inside = inside;
+    out.outside = outside;
+    out.inside_hi = inside_hi;
+    out.outside_hi = outside_hi;
+    return k;
+  }
+
+  // Evaluate candidate c, giving up as soon as it cannot beat the best
+  template <typename Skip>
+  void consider(std::size_t c,
+                selection_distances<Metric>& dist,
+                const std::vector<std::size_t>& from,
+                const Skip& skip,
+                std::size_t& best,
+                double& best_d,
+                search_diagnostics& diag) const {
+    if (skip(c))
+      return;
+    diag.candidates++;
+
+    const bool wins_tie = c < best;
+    double dc = std::numeric_limits<double>::infinity();
+    std::size_t s = 0;
+    for (; s < from.size() && (dc > best_d || (dc == best_d && wins_tie)); ++s)
+      dc = std::min(dc, dist(c, from[s]));
+
+    if (dc > best_d || (dc == best_d && wins_tie)) {
+      best = c;
+      best_d = dc;
+    } else if (s < from.size()) {
+      diag.abandoned++;
+    }
+  }
+
+  template <typename Skip>
+  void visit(std::size_t k,
+             selection_distances<Metric>& dist,
+             const std::vector<std::size_t>& from,
+             const Skip& skip,
+             std::size_t& best,
+             double& best_d,
+             search_diagnostics& diag) const {
+    const node& nd = nodes[k];
+
+    if (nd.vp == none()) {
+      for (std::size_t i = nd.begin; i < nd.end; ++i)
+        consider(items[i], dist, from, skip, best, best_d, diag);
+      return;
+    }
+
+    // The bounds need the full distance from the vantage point to `from`
+    double near = std::numeric_limits<double>::infinity();
+    for (std::size_t s = 0; s < from.size(); ++s)
+      near = std::min(near, dist(nd.vp, from[s]));
+
+    if (!skip(nd.vp)) {
+      diag.candidates++;
+      if (near > best_d || (near == best_d && nd.vp < best)) {
+        best = nd.vp;
+        best_d = near;
+      }
+    }
+
+    // Upper bounds on the distance to `from` of the points in each child,
+    // with some slack for rounding
+    std::pair<double, std::size_t> children[2] = {
+      std::make_pair((nd.inside_hi + near)*(1 + 1e-12), nd.inside),
+      std::make_pair((nd.outside_hi + near)*(1 + 1e-12), nd.outside)
+    };
+    if (children[1].first > children[0].first)
+      std::swap(children[0], children[1]);
+
+    for (int j = 0; j < 2; ++j) {
+      const std::size_t child = children[j].second;
+      if (child == none())
+        continue;
+      if (children[j].first < best_d) {
+        diag.pruned += nodes[child].end - nodes[child].begin;
+        continue;
+      }
+      visit(child, dist, from, skip, best, best_d, diag);
+    }
+  }
+
+  const Metric& d;
+  std::vector<std::size_t> items;
+  std::vector<node> nodes;
+};
+
+// Select n of N candidates that are maximally distinct under the color
+// difference d, like farthest_points() with the scan strategy on the full
+// distance matrix, and return their indices ordered by distinctness
+template <typename Metric>
+inline std::vector<std::size_t> tree_farthest_points(const Metric& d,
+                                                     std::size_t N,
+                                                     std::size_t n,
+                                                     const search_options& opts,
+                                                     search_diagnostics& diag) {
+  QUALPAL_TRACE_SPAN("tree_farthest_points");
+
+  vp_tree<Metric> tree(d, N);
+  std::vector<std::size_t> r = initial_selection(N, n);
+
+  {
+    stats_timer timer(stats_search);
+    const search_deadline deadline(opts);
+
+    selection_distances<Metric> dist(d, N, n);
+    std::vector<std::size_t> count(N), from, r_old;
+    for (std::size_t j = 0; j < n; ++j) {
+      dist.set(j, r[j]);
+      count[r[j]]++;
+    }
+
+    do {
+      QUALPAL_TRACE_SPAN("swap_pass");
+
+      r_old = r;
+      diag.iterations++;
+
+      for (std::size_t i = opts.n_fixed; i < n; ++i) {
+        if (deadline.expired(diag))
+          break;
+
+        // Candidates are all points except those held by other slots
+        count[r[i]]--;
+        from.clear();
+        for (std::size_t j = 0; j < n; ++j)
+          if (j != i)
+            from.push_back(j);
+
+        double best_d = -std::numeric_limits<double>::infinity();
+        const std::size_t best = tree.farthest_from(
+          dist, from, [&count](std::size_t c) { return count[c] > 0; }, r[i],
+          best_d, diag);
+
+        if (best != r[i])
+          dist.set(i, best);
+        r[i] = best;
+        count[best]++;
+      }
+      if (diag.timed_out || diag.cancelled)
+        break;
+      if (r != r_old && diag.iterations >= opts.max_iterations) {
+        diag.capped = true;
+        break;
+      }
+    } while (r != r_old);
+  }
+
+  // Order the selection on its own small distance matrix
+  std::vector<double> sub(n*n);
+  std::vector<std::size_t> slots(n);
+  for (std::size_t a = 0; a < n; ++a) {
+    slots[a] = a;
+    for (std::size_t b = 0; b < n; ++b)
+      sub[a + b*n] = a == b ? 0 : d(r[a], r[b]);
+  }
+
+  const std::vector<std::size_t> ordered = order_selection(sub.data(), n, slots);
+  std::vector<std::size_t> out(n);
+  for (std::size_t a = 0; a < n; ++a)
+    out[a] = r[ordered[a]];
+
+  return out;
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_METRIC_TREE_H
@@ -0,0 +1,253 @@
+// Optional hardware performance counters (cycles, instructions, last-level
+// cache misses and branch misses) around native phases, using Linux
+// perf_event_open().
+//
+// Counting is switched on at runtime with perf_start() and attributed to
+// named phases with perf_phase objects (or perf_phase_begin() and
+// perf_phase_end()). The counters follow the thread that called perf_start(),
+// so work done on worker threads during a phase is not included, and phases
+// entered on other threads are ignored; concurrent callers neither disturb a
+// session nor show up in it. Where counters cannot be opened (other
+// platforms, restrictive perf_event_paranoid settings, containers, or virtual
+// machines without a PMU) the affected counts are reported as NaN, and
+// everything else works as usual.
+
+#ifndef QUALPALR_PERF_COUNTERS_H
+#define QUALPALR_PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace qualpal {
+
+enum perf_counter_kind {
+  perf_cycles,
+  perf_instructions,
+  perf_llc_misses,
+  perf_branch_misses,
+  perf_n_counters
+};
+
+inline const char* perf_counter_name(int kind) {
+  static const char* names[perf_n_counters] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+  };
+  return names[kind];
+}
+
+struct perf_phase_counts {
+  std::string phase;
+  double counts[perf_n_counters];
+};
+
+// One file descriptor per counter, opened for the calling thread
+class perf_counters {
+public:
+  perf_counters() {
+    for (int k = 0; k < perf_n_counters; ++k)
+      fd[k] = -1;
+  }
+
+  ~perf_counters() { close(); }
+
+  // Returns true if at least one counter could be opened
+  bool open() {
+    close();
+    bool any = false;
+#if defined(__linux__)
+    static const unsigned long long config[perf_n_counters] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (int k = 0; k < perf_n_counters; ++k) {
+      struct perf_event_attr pe;
+      std::memset(&pe, 0, sizeof(pe));
+      pe.type = PERF_TYPE_HARDWARE;
+      pe.size = sizeof(pe);
+      pe.config = config[k];
+      pe.disabled = 1;
+      pe.exclude_kernel = 1;
+      pe.exclude_hv = 1;
+
+      fd[k] = static_cast<int>(syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0));
+
+      if (fd[k] >= 0) {
+        ioctl(fd[k], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[k], PERF_EVENT_IOC_ENABLE, 0);
+        any = true;
+      }
+    }
+#endif
+    return any;
+  }
+
+  void close() {
+#if defined(__linux__)
+    for (int k = 0; k < perf_n_counters; ++k) {
+      if (fd[k] >= 0)
+        ::close(fd[k]);
+      fd[k] = -1;
+    }
+#endif
+  }
+
+  // Current counter values; NaN for counters that are not available
+  void read(double* out) const {
+    for (int k = 0; k < perf_n_counters; ++k) {
+      out[k] = std::numeric_limits<double>::quiet_NaN();
+#if defined(__linux__)
+      unsigned long long value = 0;
+      if (fd[k] >= 0 && ::read(fd[k], &value, sizeof(value)) == sizeof(value))
+        out[k] = static_cast<double>(value);
+#endif
+    }
+  }
+
+private:
+  perf_counters(const perf_counters&);
+  perf_counters& operator=(const perf_counters&);
+
+  int fd[perf_n_counters];
+};
+
+// Accumulates counter deltas per phase between perf_start() and perf_stop().
+// Phases are recorded even if no counter could be opened, so that callers
+// get one (NaN) row per phase either way.
+class perf_session {
+public:
+  perf_session() : active(false) {}
+
+  bool start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    phases.clear();
+    open_phases.clear();
+    owner = std::this_thread::get_id();
+    active = true;
+    return counters.open();
+  }
+
+  std::vector<perf_phase_counts> stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    active = false;
+    counters.close();
+    std::vector<perf_phase_counts> out;
+    out.swap(phases);
+    return out;
+  }
+
+  bool is_active() const { return active; }
+
+  void begin(const std::string& phase) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active || std::this_thread::get_id() != owner)
+      return;
+    perf_phase_counts start;
+    start.phase = phase;
+    counters.read(start.counts);
+    open_phases.push_back(start);
+  }
+
+  void end(const std::string& phase) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active || std::this_thread::get_id() != owner)
+      return;
+
+    double now[perf_n_counters];
+    counters.read(now);
+
+    for (std::size_t i = open_phases.size(); i-- > 0;) {
+      if (open_phases[i].phase != phase)
+        continue;
+
+      perf_phase_counts& total = find(phase);
+      for (int k = 0; k < perf_n_counters; ++k)
+        total.counts[k] += now[k] - open_phases[i].counts[k];
+
+      open_phases.erase(open_phases.begin() + i);
+      break;
+    }
+  }
+
+private:
+  // Phases are kept in the order in which they were first seen
+  perf_phase_counts& find(const std::string& phase) {
+    for (std::size_t i = 0; i < phases.size(); ++i)
+      if (phases[i].phase == phase)
+        return phases[i];
+
+    perf_phase_counts total;
+    total.phase = phase;
+    for (int k = 0; k < perf_n_counters; ++k)
+      total.counts[k] = 0;
+    phases.push_back(total);
+    return phases.back();
+  }
+
+  std::mutex mutex;
+  std::atomic<bool> active;
+  std::thread::id owner;  // the thread that called start()
+  perf_counters counters;
+  std::vector<perf_phase_counts> phases;
+  std::vector<perf_phase_counts> open_phases;
+};
+
+inline perf_session& perf_global() {
+  static perf_session session;
+  return session;
+}
+
+inline bool perf_start() { return perf_global().start(); }
+
+inline std::vector<perf_phase_counts> perf_stop() {
+  return perf_global().stop();
+}
+
+inline void perf_phase_begin(const std::string& phase) {
+  perf_global().begin(phase);
+}
+
+inline void perf_phase_end(const std::string& phase) {
+  perf_global().end(phase);
+}
+
+// Counts the lifetime of the object towards a phase when counting is on
+class perf_phase {
+public:
+  explicit perf_phase(const char* phase)
+    : phase(phase), active(perf_global().is_active()) {
+    if (active)
+      perf_phase_begin(phase);
+  }
+
+  ~perf_phase() {
+    if (active)
+      perf_phase_end(phase);
+  }
+
+private:
+  perf_phase(const perf_phase&);
+  perf_phase& operator=(const perf_phase&);
+
+  const char* phase;
+  bool active;
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_PERF_COUNTERS_H
@@ -5,6 +5,24 @@
 
 #include <RcppArmadillo.h>
 #include <RcppParallel.h>
+#include <fstream>
+#include "async.h"
+#include "color_conversion.h"
+#include "coreset.h"
+#include "cost_model.h"
+#include "divide_conquer.h"
+#include "farthest_points.h"
+#include "hash.h"
+#include "image.h"
+#include "knn_graph.h"
+#include "locality.h"
+#include "max_n.h"
+#include "metric_tree.h"
+#include "perf_counters.h"
+#include "repulsion.h"
+#include "session.h"
+#include "stats.h"
+#include "trace.h"
 
 // [[Rcpp::depends(RcppParallel, RcppArmadillo)]]
 
@@ -29,6 +47,8 @@ struct dist_worker : public RcppParallel::Worker {
     : mat(mat), rmat(rmat) {}
 
   void operator()(std::size_t begin, std::size_t end) {
+    QUALPAL_TRACE_SPAN("dist_worker");
+
     for (std::size_t i = begin; i < end; i++) {
       for (std::size_t j = 0; j < i; j++) {
         RcppParallel::RMatrix<double>::Row row1 = mat.row(i);
@@ -43,69 +63,650 @@ struct dist_worker : public RcppParallel::Worker {
 
 // [[Rcpp::export]]
 Rcpp::NumericMatrix edist(const Rcpp::NumericMatrix mat) {
+  QUALPAL_TRACE_SPAN("edist");
+  qualpal::perf_phase phase("edist");
+  qualpal::stats_timer timer(qualpal::stats_distances);
+
   Rcpp::NumericMatrix rmat(mat.nrow(), mat.nrow());
+  qualpal::stats_add(qualpal::stats_bytes_allocated,
+                     static_cast<std::uint64_t>(mat.nrow())*mat.nrow()*
+                     sizeof(double));
   dist_worker dist_worker(mat, rmat);
-  RcppParallel::parallelFor(0, mat.nrow(), dist_worker);
+
+  const qualpal::parallel_plan plan = qualpal::current_cost_model()
+    .plan_distances(mat.nrow(), qualpal::available_threads());
+  if (plan.parallel())
+    RcppParallel::parallelFor(0, mat.nrow(), dist_worker, plan.grain);
+  else
+    dist_worker(0, mat.nrow());
 
   return rmat;
 }
 
-arma::uvec std_setdiff(const arma::uvec& x, const arma::uvec& y) {
-  std::vector<int> a = arma::conv_to< std::vector<int> >::from(arma::sort(x));
-  std::vector<int> b = arma::conv_to< std::vector<int> >::from(arma::sort(y));
-  std::vector<int> out;
+// Farthest point optimization
 
-  std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
-                      std::inserter(out, out.end()));
+// Parallel loops of the native core on RcppParallel
+struct function_worker : public RcppParallel::Worker {
+  const std::function<void(std::size_t, std::size_t)>& f;
+  explicit function_worker(const std::function<void(std::size_t, std::size_t)>& f)
+    : f(f) {}
 
-  return arma::conv_to<arma::uvec>::from(out);
+  void operator()(std::size_t begin, std::size_t end) {
+    f(begin, end);
+  }
+};
+
+// 1-based indices with the statistics of the search as an attribute
+Rcpp::IntegerVector selection(const std::vector<std::size_t>& r,
+                              const std::string& strategy,
+                              const qualpal::search_diagnostics& diag) {
+  Rcpp::IntegerVector out(r.size());
+  for (std::size_t i = 0; i < r.size(); ++i)
+    out[i] = r[i] + 1;
+
+  out.attr("diagnostics") = Rcpp::List::create(
+    Rcpp::Named("strategy")     = strategy,
+    Rcpp::Named("iterations")   = static_cast<double>(diag.iterations),
+    Rcpp::Named("candidates")   = static_cast<double>(diag.candidates),
+    Rcpp::Named("pruned")       = static_cast<double>(diag.pruned),
+    Rcpp::Named("abandoned")    = static_cast<double>(diag.abandoned),
+    Rcpp::Named("heap_updates") = static_cast<double>(diag.heap_updates),
+    Rcpp::Named("prune_rate")   = diag.prune_rate(),
+    Rcpp::Named("converged")    = !diag.capped
+  );
+
+  return out;
 }
 
-// Farthest point optimization
+// [[Rcpp::export]]
+Rcpp::IntegerVector farthest_points(const Rcpp::NumericMatrix& data,
+                                    const arma::uword n,
+                                    const std::string strategy = "heap",
+                                    const bool reorder = true) {
+  const std::size_t N = data.nrow();
+
+  // Search the candidates in Morton order, and map the result back
+  qualpal::candidate_order order;
+  Rcpp::NumericMatrix x = data;
+  if (reorder) {
+    std::vector<double> rows(3*N);
+    for (std::size_t i = 0; i < N; ++i)
+      for (int k = 0; k < 3; ++k)
+        rows[3*i + k] = data(i, k);
+    order = qualpal::morton_order(rows);
+
+    x = Rcpp::NumericMatrix(N, 3);
+    for (std::size_t i = 0; i < N; ++i)
+      for (int k = 0; k < 3; ++k)
+        x(i, k) = rows[3*order.order[i] + k];
+  }
+
+  Rcpp::NumericMatrix dm = edist(x);
+
+  qualpal::search_options opts;
+  if (strategy == "scan")
+    opts.strategy = qualpal::swap_scan;
+  else if (strategy == "pruned")
+    opts.strategy = qualpal::swap_pruned;
+  else if (strategy == "heap")
+    opts.strategy = qualpal::swap_heap;
+  else if (strategy == "local")
+    opts.strategy = qualpal::swap_local;
+  else
+    Rcpp::stop("unknown swap strategy '%s'", strategy);
+
+  qualpal::knn_graph graph;
+  if (opts.strategy == qualpal::swap_local) {
+    std::vector<double> rows(3*N);
+    for (std::size_t i = 0; i < N; ++i)
+      for (int k = 0; k < 3; ++k)
+        rows[3*i + k] = x(i, k);
+    graph = qualpal::make_knn_graph(
+      rows.data(), N, opts.n_neighbors,
+      [](std::size_t n_tasks,
+         const std::function<void(std::size_t, std::size_t)>& f) {
+        function_worker worker(f);
+        RcppParallel::parallelFor(0, n_tasks, worker, 256);
+      });
+    opts.neighbors = graph.neighbors.data();
+    opts.n_neighbors = graph.k;
+  }
+
+  qualpal::search_diagnostics diag;
+  std::vector<std::size_t> r = qualpal::initial_selection(N, n);
+  if (reorder) {
+    opts.tie_rank = order.order.data();
+    for (std::size_t i = 0; i < n; ++i)
+      r[i] = order.rank[r[i]];
+  }
+  {
+    qualpal::arena_scope scratch(qualpal::thread_arena(),
+                                 qualpal::search_scratch_bytes(N, n, opts));
+    qualpal::swap_search(dm.begin(), N, r, opts, diag);
+    r = qualpal::order_selection(dm.begin(), N, r);
+  }
+  if (reorder)
+    for (std::size_t i = 0; i < n; ++i)
+      r[i] = order.order[r[i]];
+  qualpal::stats_add(qualpal::stats_calls_global);
+  qualpal::stats_add_outcome(diag);
+
+  return selection(r, strategy, diag);
+}
+
+// Divide and conquer for large candidate sets
 
 // [[Rcpp::export]]
-arma::uvec farthest_points(const Rcpp::NumericMatrix &data,
-                           const arma::uword n) {
-  arma::mat dm = Rcpp::as<arma::mat>(edist(data));
-  arma::uword N = dm.n_cols;
+Rcpp::IntegerVector divide_points(const Rcpp::NumericMatrix& data,
+                                  const arma::uword n,
+                                  const int region_size = 1024) {
+  const std::size_t N = data.nrow();
+  std::vector<double> x(3*N);
+  for (std::size_t i = 0; i < N; ++i)
+    for (int k = 0; k < 3; ++k)
+      x[3*i + k] = data(i, k);
 
-  arma::uvec full_range = arma::linspace<arma::uvec>(0, N - 1, N);
-  arma::uvec r = arma::linspace<arma::uvec>(0, N - 1, n);
-  arma::uvec r_old(n);
+  qualpal::search_options opts;
+  qualpal::divide_options dopts;
+  dopts.region_size = region_size;
 
-  do {
-    r_old = r;
-    for (arma::uword i = 0; i < n; ++i) {
-      arma::uvec::fixed<1> ri;
+  qualpal::search_diagnostics diag;
+  std::size_t n_regions = 0;
+  std::vector<std::size_t> r = qualpal::divide_farthest_points(
+    x.data(), N, n, opts, dopts, diag, n_regions,
+    [](std::size_t n_tasks,
+       const std::function<void(std::size_t, std::size_t)>& f) {
+      function_worker worker(f);
+      RcppParallel::parallelFor(0, n_tasks, worker, 1);
+    });
 
-      ri.fill(r(i));
+  Rcpp::IntegerVector out = selection(r, "divide", diag);
+  Rcpp::List diagnostics = out.attr("diagnostics");
+  diagnostics.push_back(static_cast<double>(n_regions), "regions");
+  out.attr("diagnostics") = diagnostics;
 
-      arma::uvec incl = std_setdiff(r, ri);
-      arma::uvec excl = std_setdiff(full_range, incl);
-      arma::uvec indices = full_range(excl);
-      arma::rowvec mins = arma::min(dm.submat(incl, excl), 0);
-      r(i) = indices(mins.index_max());
-    }
-  } while (!all(r_old == r));
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::IntegerVector max_n_points(const Rcpp::NumericMatrix& data,
+                                 const double target,
+                                 const arma::uword n_max) {
+  Rcpp::NumericMatrix dm = edist(data);
+
+  const qualpal::max_n_result res =
+    qualpal::max_n_points(dm.begin(), dm.nrow(), target, n_max);
+
+  Rcpp::IntegerVector out = selection(res.indices, "max_n", res.diagnostics);
+  Rcpp::List diagnostics = out.attr("diagnostics");
+  diagnostics.push_back(static_cast<double>(res.lower), "lower");
+  diagnostics.push_back(static_cast<double>(res.upper), "upper");
+  diagnostics.push_back(static_cast<double>(res.searches), "searches");
+  out.attr("diagnostics") = diagnostics;
+
+  return out;
+}
+
+// Farthest points under other color differences, without a distance matrix
+
+// [[Rcpp::export]]
+Rcpp::IntegerVector tree_points(const Rcpp::NumericMatrix& data,
+                                const arma::uword n,
+                                const std::string metric = "din99d") {
+  const std::size_t N = data.nrow();
+  std::vector<double> x(3*N);
+  for (std::size_t i = 0; i < N; ++i)
+    for (int k = 0; k < 3; ++k)
+      x[3*i + k] = data(i, k);
+
+  qualpal::search_options opts;
+  qualpal::search_diagnostics diag;
+  std::vector<std::size_t> r;
+
+  if (metric == "din99d") {
+    const qualpal::coordinate_metric d = {x.data(), qualpal::metric_din99d};
+    r = qualpal::tree_farthest_points(d, N, n, opts, diag);
+  } else if (metric == "ciede2000") {
+    const qualpal::ciede2000_metric d(x);
+    r = qualpal::tree_farthest_points(d, N, n, opts, diag);
+  } else {
+    Rcpp::stop("unknown color difference '%s'", metric);
+  }
+  qualpal::stats_add(qualpal::stats_calls_global);
+  qualpal::stats_add_outcome(diag);
+
+  Rcpp::IntegerVector out = selection(r, "tree", diag);
+  Rcpp::List diagnostics = out.attr("diagnostics");
+  diagnostics.push_back(metric, "metric");
+  out.attr("diagnostics") = diagnostics;
+
+  return out;
+}
+
+// Force-directed placement
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix repel_points(const Rcpp::NumericVector& h,
+                                 const Rcpp::NumericVector& s,
+                                 const Rcpp::NumericVector& l,
+                                 const arma::uword n,
+                                 const bool snap = false) {
+  qualpal::hsl_box box;
+  for (int k = 0; k < 2; ++k) {
+    box.h[k] = h[k];
+    box.s[k] = s[k];
+    box.l[k] = l[k];
+  }
+
+  qualpal::repulsion_options opts;
+  if (snap)
+    opts.n_candidates = 1000;
+
+  qualpal::repulsion_diagnostics diag;
+  std::vector<std::size_t> snapped;
+  std::vector<double> hsl = qualpal::repulsion_palette(
+    box, n, opts, diag, &snapped,
+    [](std::size_t n_particles,
+       const std::function<void(std::size_t, std::size_t)>& f) {
+      function_worker worker(f);
+      RcppParallel::parallelFor(0, n_particles, worker, 16);
+    });
+
+  Rcpp::NumericMatrix out(n, 3);
+  for (std::size_t i = 0; i < n; ++i)
+    for (int k = 0; k < 3; ++k)
+      out(i, k) = hsl[3*i + k];
+
+  out.attr("diagnostics") = Rcpp::List::create(
+    Rcpp::Named("strategy")     = "repulsion",
+    Rcpp::Named("iterations")   = static_cast<double>(diag.iterations),
+    Rcpp::Named("candidates")   = static_cast<double>(diag.neighbors),
+    Rcpp::Named("pruned")       = 0.0,
+    Rcpp::Named("abandoned")    = 0.0,
+    Rcpp::Named("heap_updates") = 0.0,
+    Rcpp::Named("prune_rate")   = 0.0,
+    Rcpp::Named("converged")    = true,
+    Rcpp::Named("best_pass")    = static_cast<double>(diag.best_pass),
+    Rcpp::Named("snapped")      = !snapped.empty()
+  );
+
+  return out;
+}
+
+// Tracing
+
+// [[Rcpp::export]]
+bool trace_start() {
+  return qualpal::trace_start();
+}
+
+// [[Rcpp::export]]
+bool trace_write(const std::string file) {
+  return qualpal::trace_write(file);
+}
+
+// Hardware performance counters
+
+// [[Rcpp::export]]
+bool perf_start() {
+  return qualpal::perf_start();
+}
+
+// [[Rcpp::export]]
+void perf_phase_begin(const std::string phase) {
+  qualpal::perf_phase_begin(phase);
+}
+
+// [[Rcpp::export]]
+void perf_phase_end(const std::string phase) {
+  qualpal::perf_phase_end(phase);
+}
+
+// [[Rcpp::export]]
+Rcpp::DataFrame perf_stop() {
+  std::vector<qualpal::perf_phase_counts> phases = qualpal::perf_stop();
+
+  Rcpp::CharacterVector phase(phases.size());
+  Rcpp::List out(qualpal::perf_n_counters + 1);
+  Rcpp::CharacterVector names(qualpal::perf_n_counters + 1);
+
+  for (std::size_t i = 0; i < phases.size(); ++i)
+    phase[i] = phases[i].phase;
+
+  out[0] = phase;
+  names[0] = "phase";
+
+  for (int k = 0; k < qualpal::perf_n_counters; ++k) {
+    Rcpp::NumericVector counts(phases.size());
+    for (std::size_t i = 0; i < phases.size(); ++i)
+      counts[i] = R_IsNaN(phases[i].counts[k]) ? NA_REAL : phases[i].counts[k];
+    out[k + 1] = counts;
+    names[k + 1] = qualpal::perf_counter_name(k);
+  }
+
+  out.attr("names") = names;
+
+  return Rcpp::DataFrame(out);
+}
+
+// Images
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix image_colors(const std::string file,
+                                 const std::string format,
+                                 const int max_colors) {
+  qualpal::image_format fmt;
+  if (!qualpal::parse_image_format(format, fmt))
+    Rcpp::stop("unknown image format '%s'", format);
 
-  // Arrange the colors in the palette according to how distinct they are from
-  // one another.
-  arma::mat subdat = dm(r, r);
+  std::ifstream in(file.c_str(), std::ios::binary);
+  if (!in)
+    Rcpp::stop("cannot open '%s'", file);
 
-  // Start by finding the two most distant points in our subset
-  arma::uvec sorted = arma::ind2sub(size(subdat), subdat.index_max());
+  qualpal::grid_coreset coreset(max_colors);
+  qualpal::image_info info;
+  try {
+    info = qualpal::read_image(in, fmt, [&coreset](const double* rgb) {
+      coreset.add(rgb);
+    });
+  } catch (const std::runtime_error& e) {
+    Rcpp::stop("%s: %s", file, e.what());
+  }
+
+  const std::vector<double>& rgb = coreset.rgb();
+  const std::size_t N = coreset.size();
+  Rcpp::NumericMatrix out(N, 3);
+  for (std::size_t i = 0; i < N; ++i)
+    for (int k = 0; k < 3; ++k)
+      out(i, k) = rgb[3*i + k];
+
+  const char* formats[] = {"auto", "ppm", "pam", "raw"};
+  out.attr("image") = Rcpp::List::create(
+    Rcpp::Named("format")      = formats[info.format],
+    Rcpp::Named("width")       = static_cast<double>(info.width),
+    Rcpp::Named("height")      = static_cast<double>(info.height),
+    Rcpp::Named("pixels")      = static_cast<double>(info.pixels),
+    Rcpp::Named("transparent") = static_cast<double>(info.transparent),
+    Rcpp::Named("distinct")    = static_cast<double>(info.distinct),
+    Rcpp::Named("cell_width")  = coreset.cell_width()
+  );
+
+  return out;
+}
+
+// Cumulative statistics
+
+// [[Rcpp::export]]
+Rcpp::List stats_get() {
+  const qualpal::stats_snapshot stats = qualpal::stats_collect();
+
+  Rcpp::NumericVector counters(qualpal::stats_n_counters);
+  Rcpp::CharacterVector counter_names(qualpal::stats_n_counters);
+  for (int k = 0; k < qualpal::stats_n_counters; ++k) {
+    counters[k] = static_cast<double>(stats.counters[k]);
+    counter_names[k] = qualpal::stats_counter_name(k);
+  }
+  counters.attr("names") = counter_names;
+
+  const int P = qualpal::stats_n_phases;
+  Rcpp::CharacterVector phase(P);
+  Rcpp::NumericVector count(P), total(P), mean(P), p50(P), p90(P), p99(P),
+    p999(P), max(P);
+  for (int p = 0; p < P; ++p) {
+    const qualpal::stats_histogram& h = stats.phases[p];
+    phase[p] = qualpal::stats_phase_name(p);
+    count[p] = static_cast<double>(h.count);
+    total[p] = h.sum_ns/1e9;
+    mean[p] = h.mean_ns()/1e9;
+    p50[p] = h.quantile_ns(0.5)/1e9;
+    p90[p] = h.quantile_ns(0.9)/1e9;
+    p99[p] = h.quantile_ns(0.99)/1e9;
+    p999[p] = h.quantile_ns(0.999)/1e9;
+    max[p] = static_cast<double>(h.max_ns)/1e9;
+  }
+
+  return Rcpp::List::create(
+    Rcpp::Named("counters") = counters,
+    Rcpp::Named("phases") = Rcpp::DataFrame::create(
+      Rcpp::Named("phase") = phase,
+      Rcpp::Named("count") = count,
+      Rcpp::Named("total") = total,
+      Rcpp::Named("mean") = mean,
+      Rcpp::Named("p50") = p50,
+      Rcpp::Named("p90") = p90,
+      Rcpp::Named("p99") = p99,
+      Rcpp::Named("p999") = p999,
+      Rcpp::Named("max") = max,
+      Rcpp::Named("stringsAsFactors") = false
+    )
+  );
+}
+
+// [[Rcpp::export]]
+void stats_clear() {
+  qualpal::stats_reset();
+}
+
+// [[Rcpp::export]]
+void stats_count(const std::string counter) {
+  const int k = qualpal::stats_counter_index(counter.c_str());
+  if (k < 0)
+    Rcpp::stop("unknown counter '%s'", counter);
+  qualpal::stats_add(static_cast<qualpal::stats_counter>(k));
+}
+
+// [[Rcpp::export]]
+void stats_time(const std::string phase, const double seconds) {
+  const int k = qualpal::stats_phase_index(phase.c_str());
+  if (k < 0)
+    Rcpp::stop("unknown phase '%s'", phase);
+  qualpal::stats_record(static_cast<qualpal::stats_phase>(k),
+                        static_cast<std::uint64_t>(std::max(seconds, 0.0)*1e9));
+}
+
+// Sampling
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix torus_points(const int n) {
+  std::vector<double> x = qualpal::torus(n);
+  Rcpp::NumericMatrix out(n, 3);
+
+  for (int i = 0; i < n; ++i)
+    for (int d = 0; d < 3; ++d)
+      out(i, d) = x[3*i + d];
+
+  return out;
+}
+
+// Disk cache
+
+// [[Rcpp::export]]
+std::string hash_raw(const Rcpp::RawVector& x) {
+  return qualpal::hash_hex(qualpal::fnv1a(x.begin(), x.size()));
+}
+
+// Warm-up
+
+// [[Rcpp::export]]
+void native_warmup() {
+  // Start the TBB scheduler by running a small parallel loop
+  Rcpp::NumericMatrix x(64, 3), dm(64, 64);
+  dist_worker worker(x, dm);
+  RcppParallel::parallelFor(0, 64, worker, 1);
+
+  // Set aside scratch memory for a typical search from 1000 colors
+  qualpal::search_options opts;
+  qualpal::thread_arena().reserve(qualpal::search_scratch_bytes(1000, 25, opts));
+}
+
+// Asynchronous searches
+
+// [[Rcpp::export]]
+SEXP async_start(const Rcpp::NumericMatrix& data,
+                 const int n,
+                 const std::string engine = "global",
+                 const std::string metric = "din99d",
+                 const int region_size = 1024) {
+  std::vector<double> x(3*data.nrow());
+  for (int i = 0; i < data.nrow(); ++i)
+    for (int k = 0; k < 3; ++k)
+      x[3*i + k] = data(i, k);
 
-  // Now pick colors from the matrix in order of their color difference
-  // to the previously picked colors
-  arma::uvec sub_range = arma::linspace<arma::uvec>(0, n - 1, n);
+  qualpal::async_plan plan;
+  if (!qualpal::parse_async_engine(engine, plan.engine))
+    Rcpp::stop("unknown engine '%s'", engine);
+  if (metric != "din99d" && metric != "ciede2000")
+    Rcpp::stop("unknown color difference '%s'", metric);
+  plan.ciede2000 = metric == "ciede2000";
+  plan.region_size = region_size;
 
-  while (sorted.n_elem < n) {
-    arma::uvec excl = std_setdiff(sub_range, sorted);
-    arma::rowvec mincols = arma::min(subdat.submat(sorted, excl), 0);
-    arma::uvec::fixed<1> newrow;
-    newrow.fill(excl(mincols.index_max()));
-    sorted.insert_rows(sorted.n_elem, newrow);
+  qualpal::search_options opts;
+  return Rcpp::XPtr<qualpal::async_search>(
+    new qualpal::async_search(x, n, plan, opts), true);
+}
+
+// [[Rcpp::export]]
+bool async_ready(SEXP job) {
+  return Rcpp::XPtr<qualpal::async_search>(job)->ready();
+}
+
+// [[Rcpp::export]]
+void async_cancel(SEXP job) {
+  Rcpp::XPtr<qualpal::async_search>(job)->cancel();
+}
+
+// [[Rcpp::export]]
+Rcpp::IntegerVector async_result(SEXP job) {
+  Rcpp::XPtr<qualpal::async_search> search(job);
+  const std::vector<std::size_t>& r = search->result();
+  const qualpal::async_plan& plan = search->engine_plan();
+
+  // The same diagnostics as the synchronous engines give
+  const char* strategy = plan.engine == qualpal::async_local ? "local"
+    : plan.engine == qualpal::async_divide ? "divide"
+    : plan.engine == qualpal::async_tree ? "tree" : "heap";
+  Rcpp::IntegerVector out = selection(r, strategy, search->diagnostics());
+  Rcpp::List diagnostics = out.attr("diagnostics");
+  if (plan.engine == qualpal::async_divide)
+    diagnostics.push_back(static_cast<double>(search->regions()), "regions");
+  else if (plan.engine == qualpal::async_tree)
+    diagnostics.push_back(plan.ciede2000 ? "ciede2000" : "din99d", "metric");
+  out.attr("diagnostics") = diagnostics;
+
+  return out;
+}
+
+// Palette sessions
+
+// The palette of a session, with what the last update did
+Rcpp::List session_palette(const qualpal::palette_session& session) {
+  const std::vector<std::size_t>& r = session.palette();
+  const std::size_t n = r.size();
+  Rcpp::NumericMatrix RGB(n, 3), HSL(n, 3), DIN99d(n, 3);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      RGB(i, k) = session.rgb()[3*r[i] + k];
+      HSL(i, k) = session.hsl()[3*r[i] + k];
+      DIN99d(i, k) = session.din99d()[3*r[i] + k];
+    }
   }
 
-  return r(sorted) + 1;
+  const qualpal::session_update& update = session.last_update();
+  const qualpal::search_diagnostics& diag = update.diagnostics;
+
+  return Rcpp::List::create(
+    Rcpp::Named("RGB")    = RGB,
+    Rcpp::Named("HSL")    = HSL,
+    Rcpp::Named("DIN99d") = DIN99d,
+    Rcpp::Named("diagnostics") = Rcpp::List::create(
+      Rcpp::Named("strategy")   = "session",
+      Rcpp::Named("candidates") = static_cast<double>(session.size()),
+      Rcpp::Named("kept")       = static_cast<double>(update.kept),
+      Rcpp::Named("entered")    = static_cast<double>(update.entered),
+      Rcpp::Named("left")       = static_cast<double>(update.left),
+      Rcpp::Named("resampled")  = update.resampled,
+      Rcpp::Named("iterations") = static_cast<double>(diag.iterations),
+      Rcpp::Named("seconds")    = update.seconds,
+      Rcpp::Named("converged")  = update.converged
+    )
+  );
+}
+
+// [[Rcpp::export]]
+SEXP session_start(const int n,
+                   const int n_points,
+                   const std::string& cvd,
+                   const double cvd_severity,
+                   const double frame_budget) {
+  qualpal::session_options opts;
+  opts.n_points = n_points;
+  opts.frame_budget = frame_budget;
+  opts.cvd_severity = cvd_severity;
+  if (!qualpal::parse_cvd(cvd, opts.cvd))
+    Rcpp::stop("unknown color vision deficiency '%s'", cvd);
+
+  // Updates compute few distances, so they run on the calling thread
+  return Rcpp::XPtr<qualpal::palette_session>(
+    new qualpal::palette_session(n, opts), true);
+}
+
+// [[Rcpp::export]]
+Rcpp::List session_update(SEXP session,
+                          const Rcpp::NumericVector& h,
+                          const Rcpp::NumericVector& s,
+                          const Rcpp::NumericVector& l) {
+  Rcpp::XPtr<qualpal::palette_session> ptr(session);
+  const qualpal::hsl_box box = {{h[0], h[1]}, {s[0], s[1]}, {l[0], l[1]}};
+  ptr->update(box);
+  return session_palette(*ptr);
+}
+
+// [[Rcpp::export]]
+Rcpp::List session_refine(SEXP session) {
+  Rcpp::XPtr<qualpal::palette_session> ptr(session);
+  ptr->refine();
+  return session_palette(*ptr);
+}
+
+// Cost model
+
+struct empty_worker : public RcppParallel::Worker {
+  void operator()(std::size_t, std::size_t) {}
+};
+
+Rcpp::List cost_model_list(const qualpal::cost_model& model) {
+  return Rcpp::List::create(
+    Rcpp::Named("ns_per_distance") = model.ns_per_distance,
+    Rcpp::Named("ns_startup")      = model.ns_startup,
+    Rcpp::Named("ns_per_chunk")    = model.ns_per_chunk,
+    Rcpp::Named("threads")         = static_cast<double>(qualpal::available_threads())
+  );
+}
+
+// [[Rcpp::export]]
+Rcpp::List cost_model_get() {
+  return cost_model_list(qualpal::current_cost_model());
+}
+
+// [[Rcpp::export]]
+Rcpp::List cost_model_set(const double ns_per_distance,
+                          const double ns_startup,
+                          const double ns_per_chunk) {
+  qualpal::cost_model model = qualpal::current_cost_model();
+  model.ns_per_distance = ns_per_distance;
+  model.ns_startup = ns_startup;
+  model.ns_per_chunk = ns_per_chunk;
+  qualpal::set_cost_model(model);
+  return cost_model_list(model);
+}
+
+// [[Rcpp::export]]
+Rcpp::List cost_model_calibrate() {
+  empty_worker worker;
+  qualpal::cost_model model = qualpal::calibrate([&](std::size_t n_chunks) {
+    RcppParallel::parallelFor(0, n_chunks, worker, 1);
+  });
+  qualpal::set_cost_model(model);
+  return cost_model_list(model);
 }
@@ -0,0 +1,140 @@
+// The original edist() and farthest_points() of qualpalr, kept as a
+// reference for the optimized versions in distance.h and farthest_points.h.
+//
+// This is a direct port of the Armadillo code to the standard library: the
+// same set differences, the same column-wise minima, and the same
+// first-maximum tie-breaking, without any pruning or bookkeeping. It is slow
+// on purpose and only meant for testing; the optimized searches must select
+// exactly the same colors.
+
+#ifndef QUALPALR_REFERENCE_H
+#define QUALPALR_REFERENCE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace qualpal {
+namespace reference {
+
+// Multiset difference of sorted copies of x and y, as in std_setdiff()
+inline std::vector<std::size_t> setdiff(std::vector<std::size_t> x,
+                                        std::vector<std::size_t> y) {
+  std::vector<std::size_t> out;
+  std::sort(x.begin(), x.end());
+  std::sort(y.begin(), y.end());
+  std::set_difference(x.begin(), x.end(), y.begin(), y.end(),
+                      std::back_inserter(out));
+  return out;
+}
+
+// The N x N distance matrix (column-major) of row-major DIN99d colors
+inline std::vector<double> edist(const std::vector<double>& x) {
+  const std::size_t N = x.size()/3;
+  std::vector<double> dm(N*N, 0.0);
+
+  for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t j = 0; j < i; ++j) {
+      double out = 0;
+      for (int k = 0; k < 3; ++k)
+        out += std::pow(x[3*i + k] - x[3*j + k], 2);
+      double d = std::pow(std::sqrt(out), 0.74) * 1.28;
+      dm[i + j*N] = d;
+      dm[j + i*N] = d;
+    }
+  }
+
+  return dm;
+}
+
+// 0-based indices of the selected colors, ordered by distinctness. The
+// original loops until the selection stops changing; `max_iterations` bounds
+// the number of passes in the same way as search_options::max_iterations.
+inline std::vector<std::size_t> farthest_points(const std::vector<double>& dm,
+                                                std::size_t N,
+                                                std::size_t n,
+                                                std::size_t max_iterations = 1000) {
+  std::vector<std::size_t> full_range(N);
+  for (std::size_t i = 0; i < N; ++i)
+    full_range[i] = i;
+
+  std::vector<std::size_t> r(n, N - 1);
+  if (n > 1)
+    for (std::size_t i = 0; i < n - 1; ++i)
+      r[i] = static_cast<std::size_t>(i*(double(N - 1)/double(n - 1)));
+
+  std::vector<std::size_t> r_old;
+  std::size_t iterations = 0;
+
+  do {
+    r_old = r;
+    iterations++;
+
+    for (std::size_t i = 0; i < n; ++i) {
+      std::vector<std::size_t> incl =
+        setdiff(r, std::vector<std::size_t>(1, r[i]));
+      std::vector<std::size_t> excl = setdiff(full_range, incl);
+
+      // Column-wise minima of dm(incl, excl), then the first maximum
+      double best = -std::numeric_limits<double>::infinity();
+      std::size_t best_e = 0;
+      for (std::size_t e = 0; e < excl.size(); ++e) {
+        double m = std::numeric_limits<double>::infinity();
+        for (std::size_t s = 0; s < incl.size(); ++s)
+          m = std::min(m, dm[incl[s] + excl[e]*N]);
+        if (m > best) {
+          best = m;
+          best_e = e;
+        }
+      }
+      r[i] = excl[best_e];
+    }
+  } while (r != r_old && iterations < max_iterations);
+
+  // Order by distinctness, starting with the first maximum (in column-major
+  // order) of the submatrix
+  std::vector<double> sub(n*n);
+  for (std::size_t b = 0; b < n; ++b)
+    for (std::size_t a = 0; a < n; ++a)
+      sub[a + b*n] = dm[r[a] + r[b]*N];
+
+  const std::size_t first =
+    std::max_element(sub.begin(), sub.end()) - sub.begin();
+  std::vector<std::size_t> sorted;
+  sorted.push_back(first % n);
+  sorted.push_back(first / n);
+
+  std::vector<std::size_t> sub_range(n);
+  for (std::size_t i = 0; i < n; ++i)
+    sub_range[i] = i;
+
+  while (sorted.size() < n) {
+    std::vector<std::size_t> excl = setdiff(sub_range, sorted);
+    double best = -std::numeric_limits<double>::infinity();
+    std::size_t best_e = 0;
+    for (std::size_t e = 0; e < excl.size(); ++e) {
+      double m = std::numeric_limits<double>::infinity();
+      for (std::size_t s = 0; s < sorted.size(); ++s)
+        m = std::min(m, sub[sorted[s] + excl[e]*n]);
+      if (m > best) {
+        best = m;
+        best_e = e;
+      }
+    }
+    sorted.push_back(excl[best_e]);
+  }
+
+  std::vector<std::size_t> out(n);
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = r[sorted[i]];
+
+  return out;
+}
+
+} // namespace reference
+} // namespace qualpal
+
+#endif // QUALPALR_REFERENCE_H
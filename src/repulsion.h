@@ -0,0 +1,332 @@
+// Force-directed palette placement: an alternative to choosing among
+// discrete candidates for large palettes.
+//
+// The colors of the palette are particles that repel each other in DIN99d
+// space, with a force that falls off with the eighth power of their distance
+// and vanishes at twice the expected spacing of n colors in the color space.
+// Every pass moves each particle along the sum of the forces of its
+// neighbors (found with a uniform grid whose cells are as wide as the range
+// of the forces), maps the new position back to sRGB with the inverse color
+// transform, and projects it into the sRGB gamut and the HSL box of the
+// color space. Steps shrink over the passes, and the arrangement with the
+// largest smallest color difference seen is kept. Particles start at the
+// first n points of the torus sequence that qualpal() samples candidates
+// from, and every particle only reads the positions of the previous pass, so
+// the result does not depend on the number of threads.
+//
+// Optionally, the particles are snapped to the closest free colors among
+// the usual candidates of the color space, for palettes that consist of
+// the same colors as those of the discrete search.
+
+#ifndef QUALPALR_REPULSION_H
+#define QUALPALR_REPULSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "color_conversion.h"
+#include "distance.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct repulsion_options {
+  std::size_t iterations;    // force passes
+  double step;               // initial step, as a share of the spacing
+  std::size_t n_candidates;  // candidates to snap to (0: no snapping)
+
+  repulsion_options() : iterations(300), step(0.1), n_candidates(0) {}
+};
+
+struct repulsion_diagnostics {
+  std::size_t iterations;  // force passes
+  std::size_t neighbors;   // particle pairs within the range of the forces
+  std::size_t best_pass;   // pass that produced the result
+  double spacing;          // expected distance between neighbors
+  double min_distance;     // smallest Euclidean DIN99d difference (before
+                           // snapping)
+
+  repulsion_diagnostics()
+    : iterations(0), neighbors(0), best_pass(0), spacing(0), min_distance(0) {}
+};
+
+// Move an HSL color into an HSL box, going the shorter way around the hue
+// circle when the box does not cover all hues
+inline void clamp_to_box(const hsl_box& box, double* hsl) {
+  if (box.h[1] - box.h[0] < 360) {
+    double h = box.h[0] + std::fmod(hsl[0] - box.h[0] + 720, 360.0);
+    if (h > box.h[1])
+      h = h - box.h[1] < box.h[0] + 360 - h ? box.h[1] : box.h[0];
+    hsl[0] = h;
+  }
+  hsl[1] = std::min(std::max(hsl[1], box.s[0]), box.s[1]);
+  hsl[2] = std::min(std::max(hsl[2], box.l[0]), box.l[1]);
+}
+
+inline void hsl_din99d(const double* hsl, double* din99d) {
+  double rgb[3], xyz[3];
+  hsl_rgb(hsl, rgb);
+  rgb_xyz(rgb, xyz);
+  xyz_din99d(xyz, din99d);
+}
+
+// The HSL color in the box that is closest to a DIN99d position, as far as
+// clipping to the gamut and the box can tell
+inline void din99d_box(const hsl_box& box, const double* din99d, double* hsl) {
+  double xyz[3], rgb[3];
+  din99d_xyz(din99d, xyz);
+  xyz_rgb(xyz, rgb);
+  for (int k = 0; k < 3; ++k)
+    rgb[k] = std::min(std::max(rgb[k], 0.0), 1.0);
+  rgb_hsl(rgb, hsl);
+  clamp_to_box(box, hsl);
+}
+
+// The typical distance between n colors spread evenly over the box, from
+// the extent of a sample of it in DIN99d space (ignoring flat dimensions)
+inline double box_spacing(const hsl_box& box, std::size_t n) {
+  const std::size_t m = 1000;
+  std::vector<double> hsl = sample_hsl(box, m);
+
+  double lo[3], hi[3];
+  for (std::size_t i = 0; i < m; ++i) {
+    double lab[3];
+    hsl_din99d(&hsl[3*i], lab);
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = i == 0 ? lab[k] : std::min(lo[k], lab[k]);
+      hi[k] = i == 0 ? lab[k] : std::max(hi[k], lab[k]);
+    }
+  }
+
+  const double widest = std::max(hi[0] - lo[0],
+                                 std::max(hi[1] - lo[1], hi[2] - lo[2]));
+  double volume = 1;
+  int dims = 0;
+  for (int k = 0; k < 3; ++k) {
+    if (hi[k] - lo[k] > 0.01*widest) {
+      volume *= hi[k] - lo[k];
+      dims++;
+    }
+  }
+
+  if (dims == 0)
+    return 1;
+  return std::pow(volume/double(n), 1.0/dims);
+}
+
+// Uniform grid over particle positions for fixed-radius neighbor queries
+class particle_grid {
+public:
+  particle_grid(const std::vector<double>& pos, double width)
+    : width(width) {
+    for (std::size_t i = 0; i < pos.size()/3; ++i)
+      cells[key(cell(pos[3*i]), cell(pos[3*i + 1]), cell(pos[3*i + 2]))]
+        .push_back(i);
+  }
+
+  // Call f(j) for every particle in the cells around position p
+  template <typename F>
+  void neighbors(const double* p, F f) const {
+    const long c[3] = {cell(p[0]), cell(p[1]), cell(p[2])};
+    for (long dx = -1; dx <= 1; ++dx) {
+      for (long dy = -1; dy <= 1; ++dy) {
+        for (long dz = -1; dz <= 1; ++dz) {
+          auto it = cells.find(key(c[0] + dx, c[1] + dy, c[2] + dz));
+          if (it == cells.end())
+            continue;
+          for (std::size_t j : it->second)
+            f(j);
+        }
+      }
+    }
+  }
+
+private:
+  long cell(double x) const {
+    return static_cast<long>(std::floor(x/width));
+  }
+
+  static unsigned long long key(long x, long y, long z) {
+    const unsigned long long mask = (1ULL << 21) - 1;
+    return ((static_cast<unsigned long long>(x) & mask) << 42) |
+      ((static_cast<unsigned long long>(y) & mask) << 21) |
+      (static_cast<unsigned long long>(z) & mask);
+  }
+
+  double width;
+  std::unordered_map<unsigned long long, std::vector<std::size_t> > cells;
+};
+
+// Snap particles (HSL) to the closest free candidates of the box, in
+// particle order; returns the indices of the candidates
+inline std::vector<std::size_t> snap_to_candidates(const hsl_box& box,
+                                                   std::size_t n_candidates,
+                                                   std::vector<double>& hsl) {
+  const std::size_t n = hsl.size()/3;
+  std::vector<double> candidates = sample_hsl(box, n_candidates);
+  std::vector<double> lab(3*n_candidates);
+  for (std::size_t j = 0; j < n_candidates; ++j)
+    hsl_din99d(&candidates[3*j], &lab[3*j]);
+
+  std::vector<bool> taken(n_candidates, false);
+  std::vector<std::size_t> out(n);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    double p[3];
+    hsl_din99d(&hsl[3*i], p);
+
+    double best = std::numeric_limits<double>::infinity();
+    for (std::size_t j = 0; j < n_candidates; ++j) {
+      const double d = euclidean_distance(p, &lab[3*j]);
+      if (!taken[j] && d < best) {
+        best = d;
+        out[i] = j;
+      }
+    }
+
+    taken[out[i]] = true;
+    std::copy(&candidates[3*out[i]], &candidates[3*out[i]] + 3, &hsl[3*i]);
+  }
+
+  return out;
+}
+
+// Place n colors in an HSL box (n <= opts.n_candidates when snapping) and
+// return them as row-major HSL. Force passes run over the particles with
+// run_parallel(n, f), which must call f(begin, end) for ranges covering
+// [0, n). If `snapped` is not null, it receives the candidate indices.
+template <typename ParallelFor>
+inline std::vector<double> repulsion_palette(const hsl_box& box,
+                                             std::size_t n,
+                                             const repulsion_options& opts,
+                                             repulsion_diagnostics& diag,
+                                             std::vector<std::size_t>* snapped,
+                                             ParallelFor run_parallel) {
+  QUALPAL_TRACE_SPAN("repulsion_palette");
+  stats_add(stats_calls_repulsion);
+
+  std::vector<double> hsl = sample_hsl(box, n), next_hsl(3*n);
+  std::vector<double> pos(3*n), next_pos(3*n);
+  for (std::size_t i = 0; i < n; ++i)
+    hsl_din99d(&hsl[3*i], &pos[3*i]);
+
+  const double spacing = box_spacing(box, n);
+  const double range = 2*spacing;
+  diag.spacing = spacing;
+
+  std::vector<double> best_hsl = hsl;
+  double best = -1;
+
+  std::vector<double> nearest(n);
+  std::vector<std::size_t> pairs(n);
+
+  for (std::size_t t = 0; t <= opts.iterations; ++t) {
+    const particle_grid grid(pos, range);
+    const double step = opts.step*spacing*
+      (1 - double(t)/double(opts.iterations + 1));
+
+    run_parallel(n, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        const double* p = &pos[3*i];
+        double force[3] = {0, 0, 0};
+        double closest = range;
+        std::size_t count = 0;
+
+        grid.neighbors(p, [&](std::size_t j) {
+          if (j == i)
+            return;
+          double diff[3] = {p[0] - pos[3*j], p[1] - pos[3*j + 1],
+                            p[2] - pos[3*j + 2]};
+          const double d = std::sqrt(diff[0]*diff[0] + diff[1]*diff[1] +
+                                     diff[2]*diff[2]);
+          closest = std::min(closest, d);
+          if (d >= range)
+            return;
+          count++;
+
+          // Coincident particles push apart along a fixed direction
+          if (d == 0) {
+            diff[0] = i < j ? 1 : -1;
+            diff[1] = diff[2] = 0;
+          } else {
+            for (int k = 0; k < 3; ++k)
+              diff[k] /= d;
+          }
+
+          // A steep inverse power keeps the closest pairs in charge; the
+          // offset makes the force vanish at the range
+          const double w = std::pow(spacing/std::max(d, 1e-9*spacing), 8) -
+            std::pow(spacing/range, 8);
+          for (int k = 0; k < 3; ++k)
+            force[k] += w*diff[k];
+        });
+
+        nearest[i] = closest;
+        pairs[i] = count;
+
+        // Move by at most one step
+        const double norm = std::sqrt(force[0]*force[0] + force[1]*force[1] +
+                                      force[2]*force[2]);
+        const double scale = norm > 1 ? step/norm : step;
+        double moved[3];
+        for (int k = 0; k < 3; ++k)
+          moved[k] = p[k] + scale*force[k];
+
+        din99d_box(box, moved, &next_hsl[3*i]);
+        hsl_din99d(&next_hsl[3*i], &next_pos[3*i]);
+      }
+    });
+
+    // Particles without neighbors in range count as `range` apart
+    const double min_distance = *std::min_element(nearest.begin(),
+                                                  nearest.end());
+    if (min_distance > best) {
+      best = min_distance;
+      best_hsl = hsl;
+      diag.best_pass = t;
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+      diag.neighbors += pairs[i];
+    diag.iterations = t;
+
+    hsl.swap(next_hsl);
+    pos.swap(next_pos);
+  }
+
+  std::vector<double> lab(3*n);
+  for (std::size_t i = 0; i < n; ++i)
+    hsl_din99d(&best_hsl[3*i], &lab[3*i]);
+  diag.min_distance = std::numeric_limits<double>::infinity();
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < i; ++j)
+      diag.min_distance = std::min(diag.min_distance,
+                                   euclidean_distance(&lab[3*i], &lab[3*j]));
+
+  if (snapped && opts.n_candidates >= n)
+    *snapped = snap_to_candidates(box, opts.n_candidates, best_hsl);
+
+  return best_hsl;
+}
+
+// Force passes on a thread pool (or on the calling thread if null)
+inline std::vector<double> repulsion_palette(const hsl_box& box,
+                                             std::size_t n,
+                                             const repulsion_options& opts,
+                                             repulsion_diagnostics& diag,
+                                             std::vector<std::size_t>* snapped = 0,
+                                             thread_pool* pool = 0) {
+  const pool_loop loop = {pool, 16};
+  return repulsion_palette(box, n, opts, diag, snapped, loop);
+}
+
+} // namespace qualpal
+
+#endif // QUALPALR_REPULSION_H
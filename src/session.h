@@ -0,0 +1,402 @@
+// Palettes for an HSL color space that changes a little at a time, as while
+// the hue, saturation, or lightness slider of a palette designer is dragged.
+//
+// qualpal() scales its candidates to the color space, so any change of the
+// box moves all of them. A session instead takes its candidates from a
+// fixed sampling of the whole HSL space: the torus sequence up to some
+// index M, mapped as in sample_hsl() (hue over [0, 360), saturation by the
+// square root), of which the points inside the box are the candidates. When
+// the box changes, the candidates that stay inside keep their colors,
+// conversions, and distances to one another; only the ones that enter are
+// converted and get distances to the rest, and the ones that leave are
+// dropped. M is chosen for about n_points candidates and kept while the box
+// holds between half and twice that many, so that small changes do not
+// resample the space. Boxes too thin to hold n points of the sampling (a
+// range of zero, for instance) are sampled as by qualpal(), without reuse.
+//
+// The search then starts from the previous palette: its colors that are
+// still candidates keep their slots, and the others are replaced by the
+// nearest free candidate, so that the palette changes smoothly. An update
+// stops searching once its frame budget is spent, leaving a valid palette;
+// refine() continues the search on the same box, for instance while the
+// user pauses. Updates that keep no candidates (the first one, and those
+// that resample) cannot meet the budget anyway and search to the end, as
+// qualpal() does.
+//
+// A session is meant for one caller at a time and is not thread-safe.
+
+#ifndef QUALPALR_SESSION_H
+#define QUALPALR_SESSION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "arena.h"
+#include "color_conversion.h"
+#include "distance.h"
+#include "engine.h"
+#include "farthest_points.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace qualpal {
+
+struct session_options {
+  std::size_t n_points;  // candidates to aim for
+  double frame_budget;   // seconds per update (0: no limit)
+  cvd_type cvd;
+  double cvd_severity;
+  distance_metric metric;
+  search_options search;
+
+  session_options()
+    : n_points(1000),
+      frame_budget(1.0/60),
+      cvd(cvd_protan),
+      cvd_severity(0),
+      metric(metric_din99d) {}
+};
+
+// What an update or refinement did
+struct session_update {
+  std::size_t kept;     // candidates carried over from the previous box
+  std::size_t entered;  // candidates converted and added
+  std::size_t left;     // candidates dropped
+  bool resampled;       // the sampling of the HSL space changed
+  bool converged;       // the search finished within the frame budget
+  double seconds;
+  search_diagnostics diagnostics;
+
+  session_update()
+    : kept(0), entered(0), left(0), resampled(false), converged(false),
+      seconds(0) {}
+};
+
+// The share of the torus sequence that falls into an HSL box
+inline double hsl_box_share(const hsl_box& box) {
+  return (box.h[1] - box.h[0])/360*
+    (box.s[1]*box.s[1] - box.s[0]*box.s[0])*(box.l[1] - box.l[0]);
+}
+
+// Whether a point of the torus sequence falls into an HSL box
+inline bool in_hsl_box(const hsl_box& box, const double* u) {
+  const double h = 360*u[0];
+  const bool hue = (h >= box.h[0] && h <= box.h[1]) ||
+    (h - 360 >= box.h[0] && h - 360 <= box.h[1]);
+  return hue && u[1] >= box.s[0]*box.s[0] && u[1] <= box.s[1]*box.s[1] &&
+    u[2] >= box.l[0] && u[2] <= box.l[1];
+}
+
+class palette_session {
+public:
+  // The largest sampling of the HSL space that a session scans
+  static std::size_t max_lattice() { return std::size_t(1) << 21; }
+
+  palette_session(std::size_t n,
+                  const session_options& opts = session_options(),
+                  thread_pool* pool = 0)
+    : n(n), opts(opts), pool(pool), lattice_(0), min_de_(0) {
+    if (n < 2)
+      throw std::invalid_argument("n must be at least 2");
+    if (n > opts.n_points)
+      throw std::invalid_argument("n exceeds the number of candidate colors");
+    if (opts.cvd_severity < 0 || opts.cvd_severity > 1)
+      throw std::invalid_argument("cvd_severity must be in [0, 1]");
+  }
+
+  // Move to a new box and search from the previous palette
+  const session_update& update(const hsl_box& box) {
+    QUALPAL_TRACE_SPAN("session_update");
+    const clock::time_point start = clock::now();
+
+    if (box.h[1] - box.h[0] > 360 || box.h[0] < -360 || box.h[1] > 360 ||
+        box.h[0] > box.h[1] || box.s[0] < 0 || box.s[1] > 1 ||
+        box.s[0] > box.s[1] || box.l[0] < 0 || box.l[1] > 1 ||
+        box.l[0] > box.l[1])
+      throw std::invalid_argument("invalid HSL color space");
+
+    last = session_update();
+
+    // The lattice indices of the new candidates, resampling the space if
+    // the box holds too few or too many of them (and the sampling for the
+    // box is a different one)
+    std::size_t M = lattice_;
+    std::vector<std::size_t> next;
+    if (M > 0)
+      next = lattice_points(box, M);
+    if (M == 0 || next.size() < std::max(n, opts.n_points/2) ||
+        next.size() > 2*opts.n_points) {
+      const double share = hsl_box_share(box);
+      M = share > 0 ?
+        static_cast<std::size_t>(std::min(double(max_lattice()),
+                                          std::ceil(opts.n_points/share))) : 0;
+      if (M != lattice_)
+        next = M > 0 ? lattice_points(box, M) : std::vector<std::size_t>();
+      last.resampled = M != lattice_;
+    }
+
+    std::vector<double> next_hsl;
+    if (next.size() < n) {
+      next_hsl = sample_hsl(box, opts.n_points);
+      next.assign(opts.n_points, none());
+      last.resampled = true;
+      M = 0;
+    } else {
+      next_hsl.resize(3*next.size());
+      for (std::size_t i = 0; i < next.size(); ++i) {
+        double* c = &next_hsl[3*i];
+        torus_point(next[i], c);
+        c[0] *= 360;
+        c[1] = std::sqrt(c[1]);
+      }
+    }
+
+    // Where the candidates that stay were before (both are in lattice
+    // order; candidates off the lattice never stay)
+    const std::size_t N_old = ids_.size(), N = next.size();
+    std::vector<std::size_t> from(N, none()), to(N_old, none());
+    if (M > 0 && lattice_ > 0) {
+      std::size_t a = 0;
+      for (std::size_t i = 0; i < N; ++i) {
+        while (a < N_old && ids_[a] < next[i])
+          ++a;
+        if (a < N_old && ids_[a] == next[i]) {
+          from[i] = a;
+          to[a] = i;
+          last.kept++;
+        }
+      }
+    }
+    last.entered = N - last.kept;
+    last.left = N_old - last.kept;
+
+    rebuild(next, next_hsl, from);
+
+    // Start from the previous palette
+    std::vector<std::size_t> r;
+    if (palette_.empty()) {
+      r = initial_selection(N, n);
+    } else {
+      std::vector<char> taken(N);
+      r.assign(n, none());
+      for (std::size_t j = 0; j < n; ++j) {
+        const std::size_t i = to[palette_[j]];
+        if (i != none() && !taken[i]) {
+          r[j] = i;
+          taken[i] = 1;
+        }
+      }
+      for (std::size_t j = 0; j < n; ++j) {
+        if (r[j] != none())
+          continue;
+        double best = std::numeric_limits<double>::infinity();
+        for (std::size_t i = 0; i < N; ++i) {
+          if (taken[i])
+            continue;
+          const double d =
+            color_distance(opts.metric, &palette_din99d[3*j], &din99d_[3*i]);
+          if (d < best) {
+            best = d;
+            r[j] = i;
+          }
+        }
+        taken[r[j]] = 1;
+      }
+    }
+
+    lattice_ = M;
+    search(r, start, last.kept > 0);
+    return last;
+  }
+
+  // Continue the search on the current box for another frame
+  const session_update& refine() {
+    QUALPAL_TRACE_SPAN("session_refine");
+    const clock::time_point start = clock::now();
+
+    if (palette_.empty())
+      throw std::logic_error("the session has no color space yet");
+
+    last = session_update();
+    last.kept = ids_.size();
+    std::vector<std::size_t> r = palette_;
+    search(r, start, true);
+    return last;
+  }
+
+  // The palette, as indices into the candidates ordered by distinctness
+  const std::vector<std::size_t>& palette() const { return palette_; }
+  double min_de() const { return min_de_; }
+  const session_update& last_update() const { return last; }
+
+  // The candidates: their indices in the torus sequence (all none() if off
+  // it, with lattice() 0), colors, and coordinates
+  std::size_t size() const { return ids_.size(); }
+  std::size_t lattice() const { return lattice_; }
+  const std::vector<std::size_t>& ids() const { return ids_; }
+  const std::vector<double>& hsl() const { return hsl_; }
+  const std::vector<double>& rgb() const { return rgb_; }  // simulated
+  const std::vector<double>& din99d() const { return din99d_; }
+  const std::vector<double>& distances() const { return dm; }
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  static std::size_t none() { return std::size_t(-1); }
+
+  std::vector<std::size_t> lattice_points(const hsl_box& box,
+                                          std::size_t M) const {
+    std::vector<std::size_t> out;
+    out.reserve(static_cast<std::size_t>(M*hsl_box_share(box)*1.1) + 16);
+    for (std::size_t k = 0; k < M; ++k) {
+      double u[3];
+      torus_point(k, u);
+      if (in_hsl_box(box, u))
+        out.push_back(k);
+    }
+    return out;
+  }
+
+  // Replace the candidates, converting the new ones and computing only the
+  // distances that involve them
+  void rebuild(const std::vector<std::size_t>& next,
+               const std::vector<double>& next_hsl,
+               const std::vector<std::size_t>& from) {
+    const std::size_t N_old = ids_.size(), N = next.size();
+
+    std::vector<std::size_t> entering;
+    std::vector<double> rgb_in;
+    for (std::size_t i = 0; i < N; ++i) {
+      if (from[i] != none())
+        continue;
+      entering.push_back(i);
+      double rgb[3];
+      hsl_rgb(&next_hsl[3*i], rgb);
+      rgb_in.insert(rgb_in.end(), rgb, rgb + 3);
+    }
+
+    std::vector<double> simulated, din99d_in;
+    convert_colors(rgb_in, opts.cvd, opts.cvd_severity, simulated, din99d_in);
+
+    std::vector<double> rgb(3*N), din99d(3*N);
+    for (std::size_t i = 0; i < N; ++i) {
+      if (from[i] != none()) {
+        std::copy(&rgb_[3*from[i]], &rgb_[3*from[i]] + 3, &rgb[3*i]);
+        std::copy(&din99d_[3*from[i]], &din99d_[3*from[i]] + 3, &din99d[3*i]);
+      }
+    }
+    for (std::size_t e = 0; e < entering.size(); ++e) {
+      const std::size_t i = entering[e];
+      std::copy(&simulated[3*e], &simulated[3*e] + 3, &rgb[3*i]);
+      std::copy(&din99d_in[3*e], &din99d_in[3*e] + 3, &din99d[3*i]);
+    }
+
+    std::vector<double> next_dm(N*N);
+    {
+      QUALPAL_TRACE_SPAN("distances");
+      stats_timer timer(stats_distances);
+
+      for (std::size_t b = 0; b < N; ++b) {
+        if (from[b] == none())
+          continue;
+        const double* col = &dm[from[b]*N_old];
+        for (std::size_t a = 0; a < N; ++a)
+          if (from[a] != none())
+            next_dm[a + b*N] = col[from[a]];
+      }
+
+      // Columns of the new candidates in parallel, then their rows
+      const pool_loop loop = {pool, 16};
+      const distance_metric metric = opts.metric;
+      loop(entering.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t e = begin; e < end; ++e) {
+          const std::size_t b = entering[e];
+          for (std::size_t a = 0; a < N; ++a)
+            next_dm[a + b*N] =
+              color_distance(metric, &din99d[3*a], &din99d[3*b]);
+        }
+      });
+      for (std::size_t e = 0; e < entering.size(); ++e) {
+        const std::size_t b = entering[e];
+        for (std::size_t a = 0; a < N; ++a)
+          if (from[a] != none())
+            next_dm[b + a*N] = next_dm[a + b*N];
+      }
+      stats_add(stats_bytes_allocated, N*N*sizeof(double));
+    }
+
+    // The palette's colors, to find the nearest candidates for those that
+    // leave
+    palette_din99d.clear();
+    for (std::size_t j = 0; j < palette_.size(); ++j)
+      palette_din99d.insert(palette_din99d.end(), &din99d_[3*palette_[j]],
+                            &din99d_[3*palette_[j]] + 3);
+
+    ids_ = next;
+    hsl_ = next_hsl;
+    rgb_.swap(rgb);
+    din99d_.swap(din99d);
+    dm.swap(next_dm);
+  }
+
+  // Search from r for what is left of the frame, or to the end if limited
+  // is false
+  void search(std::vector<std::size_t>& r,
+              const clock::time_point& start,
+              bool limited) {
+    const std::size_t N = ids_.size();
+    search_options sopts = opts.search;
+    bool searched = true;
+
+    if (limited && opts.frame_budget > 0) {
+      const double left = opts.frame_budget -
+        std::chrono::duration<double>(clock::now() - start).count();
+      sopts.time_budget = left;
+      searched = left > 0;
+    }
+
+    if (searched) {
+      arena_scope scratch(thread_arena(), search_scratch_bytes(N, n, sopts));
+      swap_search(dm.data(), N, r, sopts, last.diagnostics);
+      palette_ = order_selection(dm.data(), N, r);
+      stats_add(stats_calls_global);
+      stats_add_outcome(last.diagnostics);
+    } else {
+      palette_ = order_selection(dm.data(), N, r);
+    }
+
+    last.converged = searched && !last.diagnostics.timed_out &&
+      !last.diagnostics.capped && !last.diagnostics.cancelled;
+
+    min_de_ = std::numeric_limits<double>::infinity();
+    for (std::size_t a = 0; a < n; ++a)
+      for (std::size_t b = 0; b < a; ++b)
+        min_de_ = std::min(min_de_, dist_at(dm.data(), N, palette_[a],
+                                            palette_[b]));
+
+    last.seconds = std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+  const std::size_t n;
+  const session_options opts;
+  thread_pool* pool;
+
+  std::size_t lattice_;           // M, or 0 for candidates off the lattice
+  std::vector<std::size_t> ids_;  // lattice index of every candidate
+  std::vector<double> hsl_, rgb_, din99d_;
+  std::vector<double> dm;         // column-major distance matrix
+  std::vector<std::size_t> palette_;
+  std::vector<double> palette_din99d;
+  double min_de_;
+  session_update last;
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_SESSION_H
@@ -0,0 +1,154 @@
+// A small fixed-size thread pool for the native engine.
+//
+// parallel_for() lets the calling thread work through the chunks too, so it
+// always makes progress, even when called from a task that is itself running
+// on the pool and all other workers are busy.
+
+#ifndef QUALPALR_THREAD_POOL_H
+#define QUALPALR_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace qualpal {
+
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t n_threads = 0) : stopping(false) {
+    if (n_threads == 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < n_threads; ++i)
+      workers.push_back(std::thread(&thread_pool::work, this));
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::size_t i = 0; i < workers.size(); ++i)
+      workers[i].join();
+  }
+
+  std::size_t size() const { return workers.size(); }
+
+  void submit(const std::function<void()>& task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(task);
+    }
+    wake.notify_one();
+  }
+
+  // Call f(begin, end) over chunks of [0, n) of at most `grain` items,
+  // using up to `max_threads` threads (0 for all of them) including the
+  // calling one. Returns when all chunks are done.
+  void parallel_for(std::size_t n,
+                    std::size_t grain,
+                    const std::function<void(std::size_t, std::size_t)>& f,
+                    std::size_t max_threads = 0) {
+    if (n == 0)
+      return;
+
+    grain = std::max<std::size_t>(grain, 1);
+    const std::size_t n_chunks = (n + grain - 1)/grain;
+
+    std::size_t helpers = max_threads == 0 ? size() : max_threads - 1;
+    helpers = std::min(helpers, n_chunks - 1);
+
+    std::shared_ptr<loop> state = std::make_shared<loop>(n, grain, f);
+
+    for (std::size_t i = 0; i < helpers; ++i)
+      submit(std::bind(&loop::run, state));
+
+    state->run();
+    state->wait();
+  }
+
+private:
+  // The chunks of one parallel_for(); helpers that are scheduled after all
+  // chunks have been claimed find nothing left to do and return
+  struct loop {
+    loop(std::size_t n,
+         std::size_t grain,
+         const std::function<void(std::size_t, std::size_t)>& f)
+      : n(n), grain(grain), f(f), next(0), done(0) {}
+
+    void run() {
+      for (;;) {
+        std::size_t begin = next.fetch_add(grain);
+        if (begin >= n)
+          return;
+        std::size_t end = std::min(n, begin + grain);
+        f(begin, end);
+        if (done.fetch_add(end - begin) + (end - begin) == n) {
+          std::lock_guard<std::mutex> lock(mutex);
+          finished.notify_all();
+        }
+      }
+    }
+
+    void wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (done.load() < n)
+        finished.wait(lock);
+    }
+
+    const std::size_t n, grain;
+    const std::function<void(std::size_t, std::size_t)> f;
+    std::atomic<std::size_t> next, done;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+
+  void work() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping && tasks.empty())
+          wake.wait(lock);
+        if (stopping && tasks.empty())
+          return;
+        task = tasks.front();
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()> > tasks;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+};
+
+// A parallel loop on a pool, or on the calling thread without one, for
+// algorithms that take their parallel loop as a parameter
+struct pool_loop {
+  thread_pool* pool;
+  std::size_t grain;
+
+  void operator()(std::size_t n,
+                  const std::function<void(std::size_t, std::size_t)>& f) const {
+    if (pool)
+      pool->parallel_for(n, grain, f);
+    else
+      f(0, n);
+  }
+};
+
+} // namespace qualpal
+
+#endif // QUALPALR_THREAD_POOL_H
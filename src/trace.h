@@ -0,0 +1,155 @@
+// Optional tracing of native phases in the Chrome trace event format, which
+// can be loaded into chrome://tracing or https://ui.perfetto.dev.
+//
+// Tracing is compiled in only when QUALPAL_TRACE is defined (see Makevars);
+// otherwise QUALPAL_TRACE_SPAN() expands to nothing and trace_start() and
+// trace_write() report that tracing is unavailable.
+
+#ifndef QUALPALR_TRACE_H
+#define QUALPALR_TRACE_H
+
+#include <string>
+
+#ifdef QUALPAL_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace qualpal {
+namespace trace {
+
+struct event {
+  const char* name;
+  double ts;   // microseconds since trace_start()
+  double dur;  // microseconds
+  int tid;
+};
+
+class collector {
+public:
+  collector() : active(false) {}
+
+  void start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+    origin = std::chrono::steady_clock::now();
+    active = true;
+  }
+
+  bool is_active() const { return active; }
+
+  double now() const {
+    return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - origin).count();
+  }
+
+  void record(const char* name, double ts, double dur, int tid) {
+    event e = {name, ts, dur, tid};
+    std::lock_guard<std::mutex> lock(mutex);
+    if (active)
+      events.push_back(e);
+  }
+
+  // Stop collecting and write what has been collected as JSON
+  bool write(const std::string& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    active = false;
+
+    std::ofstream out(file.c_str());
+    if (!out)
+      return false;
+
+    out << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      const event& e = events[i];
+      out << (i > 0 ? ",\n" : "\n")
+          << "{\"name\":\"" << e.name << "\",\"cat\":\"qualpal\","
+          << "\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+          << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    events.clear();
+    return bool(out);
+  }
+
+private:
+  std::mutex mutex;
+  std::atomic<bool> active;
+  std::chrono::steady_clock::time_point origin;
+  std::vector<event> events;
+};
+
+inline collector& global() {
+  static collector c;
+  return c;
+}
+
+// Small, stable ids for the threads that show up in a trace
+inline int thread_id() {
+  static std::atomic<int> next(0);
+  thread_local int id = next++;
+  return id;
+}
+
+// Records the lifetime of the object as a complete ("X") event
+class span {
+public:
+  explicit span(const char* name) : name(name), ts(-1) {
+    if (global().is_active())
+      ts = global().now();
+  }
+
+  ~span() {
+    if (ts >= 0)
+      global().record(name, ts, global().now() - ts, thread_id());
+  }
+
+private:
+  span(const span&);
+  span& operator=(const span&);
+
+  const char* name;
+  double ts;
+};
+
+} // namespace trace
+} // namespace qualpal
+
+#define QUALPAL_TRACE_CONCAT_(a, b) a##b
+#define QUALPAL_TRACE_CONCAT(a, b) QUALPAL_TRACE_CONCAT_(a, b)
+#define QUALPAL_TRACE_SPAN(name)                                               \
+  qualpal::trace::span QUALPAL_TRACE_CONCAT(qualpal_trace_span_, __LINE__)(name)
+
+namespace qualpal {
+
+inline bool trace_start() {
+  trace::global().start();
+  return true;
+}
+
+inline bool trace_write(const std::string& file) {
+  return trace::global().write(file);
+}
+
+} // namespace qualpal
+
+#else
+
+#define QUALPAL_TRACE_SPAN(name)
+
+namespace qualpal {
+
+inline bool trace_start() { return false; }
+
+inline bool trace_write(const std::string&) { return false; }
+
+} // namespace qualpal
+
+#endif // QUALPAL_TRACE
+
+#endif // QUALPALR_TRACE_H